@@ -1,5 +1,6 @@
 #include "definitions.h"
 #include "oram.hpp"
+#include "ring-oram.hpp"
 #include "utility.hpp"
 
 #include <benchmark/benchmark.h>
@@ -23,10 +24,15 @@ namespace PathORAM
 
 		inline static const auto ITERATIONS = 1 << 10;
 
+		// Ring ORAM reserved dummies and eviction rate
+		inline static const number RING_S = 5;
+		inline static const number RING_A = 3;
+
 		protected:
 		unique_ptr<ORAM> oram;
+		unique_ptr<RingORAM> ring; // set instead of oram if Ring ORAM is benchmarked
 
-		void Configure(number LOG_CAPACITY, number Z, number BLOCK_SIZE, number BATCH_SIZE)
+		void Configure(number LOG_CAPACITY, number Z, number BLOCK_SIZE, number BATCH_SIZE, bool RING)
 		{
 			this->LOG_CAPACITY = LOG_CAPACITY;
 			this->Z			   = Z;
@@ -35,6 +41,21 @@ namespace PathORAM
 			this->CAPACITY	   = (1 << LOG_CAPACITY) * Z;
 			this->ELEMENTS	   = (CAPACITY / 4) * 3;
 
+			if (RING)
+			{
+				this->ring = make_unique<RingORAM>(
+					LOG_CAPACITY,
+					BLOCK_SIZE,
+					Z,
+					RING_S,
+					RING_A,
+					make_unique<InMemoryStorageAdapter>((1 << LOG_CAPACITY) * (Z + RING_S), BLOCK_SIZE, bytes(), 1),
+					make_unique<InMemoryPositionMapAdapter>(CAPACITY + Z),
+					make_unique<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z),
+					BATCH_SIZE);
+				return;
+			}
+
 			this->oram = make_unique<ORAM>(
 				LOG_CAPACITY,
 				BLOCK_SIZE,
@@ -45,25 +66,40 @@ namespace PathORAM
 				true,
 				BATCH_SIZE);
 		}
+
+		void get(const number block, bytes &response)
+		{
+			ring ? ring->get(block, response) : oram->get(block, response);
+		}
+
+		void put(const number block, const bytes &data)
+		{
+			ring ? ring->put(block, data) : oram->put(block, data);
+		}
+
+		void multiple(const vector<block> &requests, vector<bytes> &response)
+		{
+			ring ? ring->multiple(requests, response) : oram->multiple(requests, response);
+		}
 	};
 
 	BENCHMARK_DEFINE_F(ORAMBenchmark, Payload)
 	(benchmark::State& state)
 	{
-		Configure(state.range(0), state.range(1), state.range(2), state.range(3));
+		Configure(state.range(0), state.range(1), state.range(2), state.range(3), state.range(4));
 
 		// put all
 		for (number id = 0; id < ELEMENTS; id++)
 		{
 			auto data = fromText(to_string(id), BLOCK_SIZE);
-			oram->put(id, data);
+			put(id, data);
 		}
 
 		// get all
 		for (number id = 0; id < ELEMENTS; id++)
 		{
 			bytes returned;
-			oram->get(id, returned);
+			get(id, returned);
 		}
 
 		// random operations
@@ -94,7 +130,7 @@ namespace PathORAM
 				if (batch.size() > 0)
 				{
 					vector<bytes> response;
-					oram->multiple(batch, response);
+					multiple(batch, response);
 
 					batch.clear();
 				}
@@ -104,27 +140,34 @@ namespace PathORAM
 
 	BENCHMARK_REGISTER_F(ORAMBenchmark, Payload)
 		// base case
-		->Args({5, 3, 32, 1})
+		->Args({5, 3, 32, 1, false})
 
 		// change Log(N)
-		->Args({7, 3, 32, 1})
-		->Args({9, 3, 32, 1})
-		->Args({11, 3, 32, 1})
+		->Args({7, 3, 32, 1, false})
+		->Args({9, 3, 32, 1, false})
+		->Args({11, 3, 32, 1, false})
 
 		// change Z
-		->Args({5, 4, 32, 1})
-		->Args({5, 5, 32, 1})
-		->Args({5, 6, 32, 1})
+		->Args({5, 4, 32, 1, false})
+		->Args({5, 5, 32, 1, false})
+		->Args({5, 6, 32, 1, false})
 
 		// change block size
-		->Args({5, 3, 1024, 1})
-		->Args({5, 3, 2048, 1})
-		->Args({5, 3, 4096, 1})
+		->Args({5, 3, 1024, 1, false})
+		->Args({5, 3, 2048, 1, false})
+		->Args({5, 3, 4096, 1, false})
 
 		// change batch size
-		->Args({5, 3, 32, 10})
-		->Args({5, 3, 32, 25})
-		->Args({5, 3, 32, 50})
+		->Args({5, 3, 32, 10, false})
+		->Args({5, 3, 32, 25, false})
+		->Args({5, 3, 32, 50, false})
+
+		// Ring ORAM against PathORAM (PathORAM 5, 4, 32, 1 is above)
+		->Args({5, 4, 32, 1, true})
+		->Args({9, 4, 32, 1, false})
+		->Args({9, 4, 32, 1, true})
+		->Args({5, 4, 1024, 1, false})
+		->Args({5, 4, 1024, 1, true})
 
 		->Iterations(ORAMBenchmark::ITERATIONS)
 		->Unit(benchmark::kMillisecond);
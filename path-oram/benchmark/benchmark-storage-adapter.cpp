@@ -13,12 +13,17 @@ namespace PathORAM
 	{
 #if USE_REDIS
 		StorageAdapterTypeRedis,
+		StorageAdapterTypePipelinedRedis,
 #endif
 // #if USE_AEROSPIKE
 // 		StorageAdapterTypeAerospike,
 // #endif
 		StorageAdapterTypeInMemory,
-		StorageAdapterTypeFileSystem
+		StorageAdapterTypeFileSystem,
+		StorageAdapterTypeMappedFileSystem,
+#if USE_IO_URING
+		StorageAdapterTypeIOUring
+#endif
 	};
 
 	class StorageAdapterBenchmark : public ::benchmark::Fixture
@@ -48,10 +53,21 @@ namespace PathORAM
 				case StorageAdapterTypeFileSystem:
 					adapter = make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, 1);
 					break;
+				case StorageAdapterTypeMappedFileSystem:
+					adapter = make_unique<MappedFileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, 1);
+					break;
+#if USE_IO_URING
+				case StorageAdapterTypeIOUring:
+					adapter = make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, 1);
+					break;
+#endif
 #if USE_REDIS
 				case StorageAdapterTypeRedis:
 					adapter = make_unique<RedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), REDIS_HOST, false, 1);
 					break;
+				case StorageAdapterTypePipelinedRedis:
+					adapter = make_unique<PipelinedRedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), REDIS_HOST, false, 1);
+					break;
 #endif
 // #if USE_AEROSPIKE
 // 				case StorageAdapterTypeAerospike:
@@ -135,7 +151,15 @@ namespace PathORAM
 			->Args({StorageAdapterTypeInMemory, 1})
 			->Args({StorageAdapterTypeInMemory, 16})
 			->Args({StorageAdapterTypeFileSystem, 1})
-			->Args({StorageAdapterTypeFileSystem, 16});
+			->Args({StorageAdapterTypeFileSystem, 16})
+			->Args({StorageAdapterTypeMappedFileSystem, 1})
+			->Args({StorageAdapterTypeMappedFileSystem, 16});
+
+#if USE_IO_URING
+		b
+			->Args({StorageAdapterTypeIOUring, 1})
+			->Args({StorageAdapterTypeIOUring, 16});
+#endif
 
 		auto iterations = 1 << 15;
 
@@ -151,7 +175,9 @@ namespace PathORAM
 
 				b
 					->Args({StorageAdapterTypeRedis, 1})
-					->Args({StorageAdapterTypeRedis, 16});
+					->Args({StorageAdapterTypeRedis, 16})
+					->Args({StorageAdapterTypePipelinedRedis, 1})
+					->Args({StorageAdapterTypePipelinedRedis, 16});
 				iterations									= 1 << 10;
 				PathORAM::StorageAdapterBenchmark::CAPACITY = 1 << 12;
 
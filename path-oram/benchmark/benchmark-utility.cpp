@@ -95,6 +95,22 @@ namespace PathORAM
 		}
 	}
 
+	BENCHMARK_DEFINE_F(UtilityBenchmark, CipherContext)
+	(benchmark::State& state)
+	{
+		__blockCipherMode = (BlockCipherMode)state.range(0);
+
+		// a path of 16 buckets, 4 KB each
+		const auto count = 16uLL, stride = 4096uLL;
+		auto buffer		 = getRandomBlock(count * stride);
+		CipherContext context(getRandomBlock(KEYSIZE));
+
+		for (auto _ : state)
+		{
+			context.crypt(buffer.data(), count, stride, ENCRYPT);
+		}
+	}
+
 	BENCHMARK_REGISTER_F(UtilityBenchmark, Random)
 		->Iterations(1 << 20)
 		->Unit(benchmark::kMicrosecond);
@@ -115,6 +131,12 @@ namespace PathORAM
 		->Args({CTR})
 		->Iterations(1 << 15)
 		->Unit(benchmark::kMicrosecond);
+
+	BENCHMARK_REGISTER_F(UtilityBenchmark, CipherContext)
+		->Args({CBC})
+		->Args({CTR})
+		->Iterations(1 << 12)
+		->Unit(benchmark::kMicrosecond);
 }
 
 BENCHMARK_MAIN();
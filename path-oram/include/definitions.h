@@ -13,6 +13,10 @@
 #define USE_REDIS true
 #endif
 
+#ifndef USE_IO_URING
+#define USE_IO_URING true
+#endif
+
 // #ifndef USE_AEROSPIKE
 // #define USE_AEROSPIKE true
 // #endif
@@ -24,6 +28,44 @@
 #define HASHSIZE 256
 #define HASH_ALGORITHM EVP_sha256
 
+// alignment used for memory regions touched on every access
+#define CACHE_LINE_SIZE 64
+
+// bytes of CSPRNG output buffered per thread (small requests are served from the buffer)
+#define RANDOM_BUFFER_SIZE 4096
+
+// compile-time trace levels, anything above TRACE_LEVEL is removed by the preprocessor
+#define TRACE_NONE 0
+#define TRACE_ERROR 1
+#define TRACE_WARNING 2
+#define TRACE_INFO 3
+#define TRACE_ACCESS 4 // every ORAM access, debug builds only
+
+// production builds trace nothing (and pay nothing)
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_NONE
+#endif
+
+// number of the latest trace messages kept in memory (see getTrace)
+#define TRACE_BUFFER_SIZE 1024
+
+// records a message (string or boost::format) in the trace ring buffer if level is enabled
+#if TRACE_LEVEL > TRACE_NONE
+#define TRACE(level, message)                         \
+	do                                                \
+	{                                                 \
+		if constexpr ((level) <= TRACE_LEVEL)         \
+		{                                             \
+			::PathORAM::traceMessage(level, message); \
+		}                                             \
+	} while (false)
+#else
+#define TRACE(level, message) \
+	do                        \
+	{                         \
+	} while (false)
+#endif
+
 // change to run all tests from different seed
 #define TEST_SEED 0x13
 
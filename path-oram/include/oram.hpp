@@ -4,8 +4,17 @@
 #include "position-map-adapter.hpp"
 #include "stash-adapter.hpp"
 #include "storage-adapter.hpp"
+#include "tree.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -15,6 +24,63 @@ namespace PathORAM
 
 	class AbsPositionMapAdapter;
 
+	/**
+	 * @brief a flat cache of the buckets of one or several paths
+	 *
+	 * Buckets are stored contiguously in the order they were added (ready to be a storage SET request as is).
+	 * A bucket is looked up through its level (a location on level l is in [2^l, 2^(l + 1))):
+	 * per level, indices are kept sorted by location, so there is no hashing.
+	 * Clearing keeps the allocated memory for the next access.
+	 */
+	class BucketCache
+	{
+		private:
+		vector<pair<number, bucket>> entries; // {location, bucket} in the order of insertion
+		vector<vector<number>> levels;		  // indices in entries per level, sorted by location
+
+		/**
+		 * @brief the position of the location in its level's index (where it is or should be inserted)
+		 */
+		vector<number>::const_iterator position(const vector<number> &level, const number location) const;
+
+		public:
+		/**
+		 * @brief Construct an empty cache
+		 *
+		 * @param height number of tree levels
+		 */
+		BucketCache(const number height);
+
+		/**
+		 * @brief finds a bucket
+		 *
+		 * @param location the bucket location in the tree
+		 * @return bucket* the bucket, or nullptr if it is not in the cache
+		 */
+		bucket *find(const number location);
+		const bucket *find(const number location) const;
+
+		/**
+		 * @brief finds a bucket, adds an empty one if it is not in the cache
+		 *
+		 * @param location the bucket location in the tree
+		 * @return bucket& the bucket
+		 */
+		bucket &operator[](const number location);
+
+		/**
+		 * @brief removes all buckets
+		 */
+		void clear();
+
+		/**
+		 * @return all buckets in a form of {location, bucket}
+		 */
+		const vector<pair<number, bucket>> &all() const;
+
+		number size() const;
+	};
+
 	/**
 	 * @brief PathORAM class
 	 *
@@ -35,12 +101,111 @@ namespace PathORAM
 		const number height;  // number of tree levels
 		const number buckets; // total number of buckets
 		const number blocks;  // total number of blocks
+		const Tree tree;	  // paths, levels and bucket locations
 
 		const number batchSize; // a max number of requests to process at a time (default 1)
 
 		// a layer between (expensive) storage and the protocol;
 		// holds items (buckets of blocks) in memory and unencrypted;
-		unordered_map<number, bucket> cache;
+		BucketCache cache;
+
+		// the top treeTopLevels levels of the tree (locations 1 to 2^treeTopLevels - 1) are kept in memory and unencrypted permanently;
+		// these buckets are on every path, so keeping them never reaches the storage (written back on destruction)
+		const number treeTopLevels;
+		vector<bucket> treeTop; // indexed by location, 0 is unused
+
+		// deterministic eviction: if not 0, an access only takes its block off the path,
+		// and every evictionRate accesses the next path in reverse-lexicographic order is evicted
+		const number evictionRate;
+		number accesses	 = 0; // accesses since the last eviction
+		number evictions = 0; // number of evictions so far (defines the next eviction path)
+
+		// asynchronous write-back: if writeBackLimit is not 0, syncCache hands the cache over to a background writer;
+		// buckets in flight stay in pending (oldest first) until written, and reads of them are served from there
+		const number writeBackLimit;
+		deque<BucketCache> pending;
+		mutex pendingLock;
+		condition_variable pendingChanged;
+		bool stopping = false;
+		exception_ptr writeBackError; // the failure of a background write, rethrown by the next syncCache or flushWriteBack
+		thread writer;
+
+		// storage adapters are not required to be thread-safe, the calls are serialized
+		// unless the adapter supports concurrent GET and SET
+		mutex storageLock;
+
+		/**
+		 * @brief locks the storage for a call, if the adapter requires it
+		 *
+		 * @return unique_lock<mutex> the lock, owns storageLock only if the adapter does not support concurrent GET and SET
+		 */
+		unique_lock<mutex> lockStorage();
+
+		/**
+		 * @brief moves the locations that are in flight (in pending write-backs) to the cache
+		 *
+		 * @param locations the locations to look up, the found ones are removed
+		 * @param response the found blocks are appended here, unless dryRun
+		 * @param dryRun if set, will not populate response
+		 */
+		void takePending(vector<number> &locations, vector<block> &response, const bool dryRun);
+
+		/**
+		 * @brief starts downloading the buckets of a path in the background
+		 *
+		 * Buckets in the cache, in the tree top or in flight are not downloaded (the cache has them or gets them now).
+		 *
+		 * @param path the locations of the path
+		 * @return future<vector<pair<number, bucket>>> the downloaded buckets in a form of {location, bucket}
+		 */
+		future<vector<pair<number, bucket>>> prefetchPath(const unordered_set<number> &path);
+
+		/**
+		 * @brief the background writer loop: write the oldest pending buckets, until stopped and drained
+		 */
+		void writeBack();
+
+		/**
+		 * @brief blocks until all pending write-backs are written
+		 *
+		 * Throws the failure of a background write, if any (the failed write-back stays pending and is retried).
+		 */
+		void flushWriteBack();
+
+		/**
+		 * @brief rethrows the failure of a background write, if any, and lets the writer retry it
+		 *
+		 * Must be called with pendingLock held.
+		 */
+		void rethrowWriteBackError();
+
+		/**
+		 * @brief computes how many top levels of the tree fit in the given memory budget
+		 *
+		 * @param treeTopSize budget in bytes (decrypted buckets, Z * (ID + payload) each)
+		 * @param height number of tree levels
+		 * @param Z number of blocks per bucket
+		 * @param dataSize size of the payload in bytes
+		 * @return number the number of levels (0 to height)
+		 */
+		static number levelsForTreeTop(const number treeTopSize, const number height, const number Z, const number dataSize);
+
+		/**
+		 * @brief checks if the location is held in the tree-top cache (and never goes to storage)
+		 */
+		bool inTreeTop(const number location) const;
+
+		/**
+		 * @brief (re)reads the tree-top buckets from the storage
+		 */
+		void loadTreeTop();
+
+		/**
+		 * @brief throws if any request refers to a block out of bound
+		 *
+		 * @param requests the requests in a form of {ID, payload}
+		 */
+		void checkBlocks(const vector<block> &requests) const;
 
 		/**
 		 * @brief performs a single access, read or write
@@ -52,6 +217,27 @@ namespace PathORAM
 		 */
 		void access(const bool read, const number block, const bytes &data, bytes &response);
 
+		/**
+		 * @brief brings the block from its path to stash (step 2 of the access)
+		 *
+		 * Reads the whole path into stash, or, in the deterministic eviction mode,
+		 * only takes the block off the path (the path is rewritten with a dummy in its place).
+		 *
+		 * @param leaf the leaf the block was mapped to
+		 * @param block the block ID requested
+		 */
+		void fetchBlock(const number leaf, const number block);
+
+		/**
+		 * @brief evicts the stash after an access (step 4 of the access)
+		 *
+		 * Writes the read path back, or, in the deterministic eviction mode,
+		 * evicts along the next reverse-lexicographic path every evictionRate accesses.
+		 *
+		 * @param leaf the leaf of the path that was read
+		 */
+		void evictAfterAccess(const number leaf);
+
 		/**
 		 * @brief puts a path into the stash
 		 *
@@ -72,32 +258,17 @@ namespace PathORAM
 		void writePath(const number leaf);
 
 		/**
-		 * @brief checks if the paths "merge" on the level
+		 * @brief write a union of paths using the blocks from stash and the blocks read from those paths (combined eviction of a batch)
 		 *
-		 * @param pathLeaf leaf that defines the first path
-		 * @param blockPosition leaf that defines the second path
-		 * @param level level in question
-		 * @return true if the paths share the same node on the given level
-		 * @return false otherwise
-		 */
-		bool canInclude(const number pathLeaf, const number blockPosition, const number level) const;
-
-		/**
-		 * @brief computes the location in the storage for a bucket (not block) in a given path on a given level
-		 *
-		 * @param level level in question
-		 * @param leaf leaf that defines the path in question
-		 * @return number the location of the requested bucket (not block) in the storage
-		 */
-		number bucketForLevelLeaf(const number level, const number leaf) const;
-
-		/**
-		 * @brief compute a range of possible leaves for the bucket
+		 * Buckets are filled from the deepest to the root;
+		 * a block goes to the deepest bucket of the union on its path, or is carried up to the parent if it is full.
+		 * Fetched blocks that did not fit are put in stash.
 		 *
-		 * @param location the bucket location in the tree
-		 * @return pair<number, number> {from, to} inclusive leaves that would satisfy the invariant
+		 * @param locations the bucket locations of the union of paths (with all their ancestors)
+		 * @param knownLeaves the leaves of some blocks that are already known (saves position map lookups)
+		 * @param fetched the blocks read from the paths (not in stash), will be moved from
 		 */
-		pair<number, number> leavesForLocation(const number location);
+		void writePaths(const unordered_set<number> &locations, const unordered_map<number, number> &knownLeaves, vector<block> &fetched);
 
 		/**
 		 * @brief make GET requests to the storage through cache.
@@ -106,31 +277,49 @@ namespace PathORAM
 		 * @param locations the addresses of the blocks to read
 		 * @param response the read blocks split into ORAM id and payload
 		 * @param dryRun if set, will not populate response (will only download and put in interanal cache)
+		 *
+		 * \note
+		 * Unless dryRun, the payloads are moved (not copied) to response and the cache keeps only the IDs,
+		 * so the caller must rewrite these locations (setCache) before the cache is synced (see guardCache).
+		 * Tree-top payloads are copied.
 		 */
 		void getCache(const unordered_set<number> &locations, vector<block> &response, const bool dryRun);
 
+		/**
+		 * @brief runs the steps of an access (from reading the paths to rewriting them), dropping the cache if they throw
+		 *
+		 * @param steps the steps to run
+		 */
+		void guardCache(const function<void()> &steps);
+
 		/**
 		 * @brief make SET requests to the storage through cache.
 		 * This will NOT update the storage, only the cache (see syncCache).
 		 *
-		 * @param requests the set requests in a form of {address, {bucket of {ORAM ID, payload}}}
+		 * @param requests the set requests in a form of {address, {bucket of {ORAM ID, payload}}}, moved into the cache
 		 */
-		void setCache(const vector<pair<number, bucket>> &requests);
+		void setCache(vector<pair<number, bucket>> &&requests);
 
 		/**
 		 * @brief upload all cache content to the storage and empty the cache
+		 *
+		 * @param keep the locations to keep in the cache after the upload (e.g. shared with the next access)
 		 */
-		void syncCache();
+		void syncCache(const unordered_set<number> &keep = unordered_set<number>());
 
-		friend class ORAMTest_LeavesForLocation_Test;
-		friend class ORAMTest_BucketFromLevelLeaf_Test;
-		friend class ORAMTest_CanInclude_Test;
 		friend class ORAMTest_ReadPath_Test;
 		friend class ORAMTest_ConsistencyCheck_Test;
 		friend class ORAMTest_MultipleCheckCache_Test;
 		friend class ORAMTest_MultipleGetNoDuplicates_Test;
+		friend class ORAMTest_TreeTopLevels_Test;
+		friend class ORAMTest_DeterministicEviction_Test;
+		friend class ORAMTest_AsyncWriteBack_Test;
+		friend class ORAMTest_AsyncWriteBackError_Test;
+		friend class ORAMTest_AccessError_Test;
 		friend class ORAMBigTest;
 
+		friend class ConcurrentORAM;
+
 		public:
 		/**
 		 * @brief Construct a new ORAM object given adapters
@@ -146,6 +335,14 @@ namespace PathORAM
 		 * @param stash pointer to stash adapter to use
 		 * @param initialize whether to initialize map and storage (should be false if map and storage are read from files)
 		 * @param batchSize controls the max number of requests in multiple(...)
+		 * @param treeTopSize memory budget in bytes for the tree-top cache;
+		 * as many top levels as fit are kept decrypted in memory and skip the storage (0 disables the cache)
+		 * @param evictionRate if not 0, enables the deterministic eviction mode:
+		 * an access only takes the requested block off its path, and every evictionRate accesses
+		 * a path in reverse-lexicographic order is evicted (0 writes back the read path, as in the paper)
+		 * @param writeBackLimit if not 0, an access returns as soon as the block is in stash,
+		 * and the re-encrypted path is written back by a background thread with at most this many write-backs pending
+		 * (0 writes back synchronously)
 		 */
 		ORAM(
 			const number logCapacity,
@@ -154,8 +351,18 @@ namespace PathORAM
 			const shared_ptr<AbsStorageAdapter> storage,
 			const shared_ptr<AbsPositionMapAdapter> map,
 			const shared_ptr<AbsStashAdapter> stash,
-			const bool initialize  = true,
-			const number batchSize = 1);
+			const bool initialize	 = true,
+			const number batchSize	 = 1,
+			const number treeTopSize = 0,
+			const number evictionRate = 0,
+			const number writeBackLimit = 0);
+
+		/**
+		 * @brief Destroy the ORAM object, finishing pending write-backs and writing the tree-top cache (if any) back to the storage
+		 *
+		 * A write-back that failed is retried once; if it fails again, its buckets are dropped (destructor must not throw).
+		 */
+		~ORAM();
 
 		/**
 		 * @brief Construct a new ORAM object with adapters created automatically
@@ -190,12 +397,23 @@ namespace PathORAM
 		 */
 		void put(const number block, const bytes &data);
 
+		/**
+		 * @brief Reads a block and writes its modified version in a single ORAM access
+		 *
+		 * @param block block ID to request
+		 * @param modifier receives the (decrypted) data of the block, empty if it was never written, and modifies it in place
+		 * @param response the data from the block before the modification
+		 */
+		void update(const number block, const function<void(bytes &)> &modifier, bytes &response);
+
 		/**
 		 * @brief processes multiple requests at a time
 		 *
-		 * \note
-		 * If a sequence contains duplicates, those duplicate requests will miss the cache.
-		 * The answer will still be correct, and operation secure, just not optimal.
+		 * The union of the paths is read once, all requests are served from the stash in order
+		 * (so duplicates see the preceding requests, last write wins),
+		 * and the stash is evicted along the union in one combined write-back.
+		 * Each distinct block is remapped once; a repeated block reads a random path instead,
+		 * so the batch does not reveal duplicates.
 		 *
 		 * @param requests the sequence of requests in a form of {ID, payload}
 		 * If payload is empty (zero size), the requests is treated as GET, otherwise PUT.
@@ -206,9 +424,28 @@ namespace PathORAM
 		 *
 		 * \note
 		 * The number fo request must not exceed the batchSize parameter used to construct the ORAM.
+		 * All block IDs are checked before the batch starts, so an invalid request fails the batch with no effect.
 		 */
 		void multiple(const vector<block> &requests, vector<bytes> &response);
 
+		/**
+		 * @brief processes a sequence of requests one access at a time, downloading the path of the next request
+		 * while the current one is evicted and written back
+		 *
+		 * The buckets shared by the two paths are not downloaded, the next access takes them from the cache.
+		 * The download and the write-back run concurrently if the storage adapter supports it
+		 * (see AbsStorageAdapter::supportsConcurrentGetSet).
+		 *
+		 * In the deterministic eviction mode, each access takes its block off the path and the evictions follow evictionRate, as in get / put.
+		 *
+		 * @param requests the sequence of requests in a form of {ID, payload}, as in multiple (the batchSize does not apply)
+		 * @param response the answer to the requests, as in multiple
+		 *
+		 * \note
+		 * All block IDs are checked before the first access, so an invalid request fails the sequence with no effect.
+		 */
+		void pipeline(const vector<block> &requests, vector<bytes> &response);
+
 		/**
 		 * @brief bulk loads the data bypassing usual ORAM protocol
 		 *
@@ -227,4 +464,94 @@ namespace PathORAM
 		 */
 		void load(vector<block> &data);
 	};
+
+	/**
+	 * @brief Thread-safe front end for an ORAM
+	 *
+	 * Any number of threads submit get / put requests and receive futures.
+	 * Requests go through a lock-free multi-producer single-consumer queue to a dedicated worker thread,
+	 * which groups them into batches of up to batchSize and executes each batch with ORAM::multiple.
+	 * Requests are executed in the order they were enqueued.
+	 *
+	 * \note
+	 * The underlying ORAM (and its adapters) must not be used directly while the front end exists.
+	 */
+	class ConcurrentORAM
+	{
+		private:
+		// a queued request, also a node of the intrusive queue
+		struct Request
+		{
+			number block;
+			bytes data; // empty for GET
+			promise<bytes> response;
+			atomic<Request *> next = nullptr;
+		};
+
+		const shared_ptr<ORAM> oram;
+		const number batchSize;
+
+		// Vyukov's intrusive MPSC queue: producers exchange head, the worker alone pops from tail
+		atomic<Request *> head;
+		Request *tail;
+		Request stub;
+
+		atomic<number> pending = 0; // number of requests pushed and not yet popped
+		atomic<bool> sleeping  = false;
+		atomic<bool> stopping  = false;
+		mutex wakeLock;
+		condition_variable wake;
+
+		thread worker;
+
+		/**
+		 * @brief enqueue a request (any thread) and wake the worker if needed
+		 */
+		future<bytes> submit(const number block, const bytes &data);
+
+		void push(Request *request);
+
+		/**
+		 * @brief dequeue a request (worker only)
+		 *
+		 * @return Request* the oldest request, or nullptr if the queue is empty (or a producer is mid-push)
+		 */
+		Request *pop();
+
+		/**
+		 * @brief the worker loop: collect a batch, run it through ORAM::multiple, fulfill the futures
+		 */
+		void run();
+
+		public:
+		/**
+		 * @brief Construct a new Concurrent ORAM object and start its worker thread
+		 *
+		 * @param oram the ORAM to serve the requests
+		 * @param batchSize the max number of requests executed at a time (must not exceed the batchSize of the ORAM)
+		 */
+		ConcurrentORAM(const shared_ptr<ORAM> oram, const number batchSize);
+
+		/**
+		 * @brief Destroy the Concurrent ORAM object, after all submitted requests are executed
+		 */
+		~ConcurrentORAM();
+
+		/**
+		 * @brief Retrives a block from ORAM asynchronously
+		 *
+		 * @param block block ID to request
+		 * @return future<bytes> the (decrypted) data from the block
+		 */
+		future<bytes> get(const number block);
+
+		/**
+		 * @brief Puts a block to ORAM asynchronously
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block, must not be empty
+		 * @return future<bytes> the supplied data, ready when the block is written
+		 */
+		future<bytes> put(const number block, const bytes &data);
+	};
 }
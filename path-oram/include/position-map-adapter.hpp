@@ -31,6 +31,17 @@ namespace PathORAM
 		 */
 		virtual void set(const number block, const number leaf) = 0;
 
+		/**
+		 * @brief map a new leaf to the block and return the old one (the remap step of ORAM access)
+		 *
+		 * The default is get followed by set; adapters that can do it in one operation should override.
+		 *
+		 * @param block block in question
+		 * @param leaf the new leaf
+		 * @return number the leaf mapped to this block before the call
+		 */
+		virtual number getAndSet(const number block, const number leaf);
+
 		virtual ~AbsPositionMapAdapter() = 0;
 	};
 
@@ -79,17 +90,64 @@ namespace PathORAM
 		void loadFromFile(const string filename);
 	};
 
+	/**
+	 * @brief Bit-packed implementation of position adapter.
+	 *
+	 * Leaves of a tree of height logCapacity are numbered from 0 to 2^(logCapacity - 1),
+	 * so each takes logCapacity - 1 bits (not 64) in a packed array of words.
+	 * The array is either anonymous memory, or a memory-mapped file;
+	 * in the latter case the map is persisted as it is updated and a restart does not read or rewrite it in full.
+	 */
+	class PackedPositionMapAdapter : public AbsPositionMapAdapter
+	{
+		private:
+		const number capacity; // maximum capacity, number of entries
+		const number width;	   // bits per entry
+		const number mask;	   // width lowest bits set
+		const number mapSize;  // size of the packed array (and the file) in bytes
+
+		number* words; // the packed array
+		int file = -1;	 // the backing file, -1 if anonymous
+
+		/**
+		 * @brief helper that throws exception if out-of-bounds access occurs
+		 *
+		 * @param block accessed block
+		 */
+		void checkCapacity(const number block) const;
+
+		friend class PositionMapAdapterTest_PackedWidth_Test;
+
+		public:
+		/**
+		 * @brief Construct a new Packed Position Map Adapter object
+		 *
+		 * @param capacity maximum capacity (number of entries)
+		 * @param logCapacity height of the ORAM tree whose leaves are stored (defines the entry width)
+		 * @param filename the file to map (empty for anonymous memory)
+		 * @param override if true, the file is (re)created and zeroed; otherwise, the existing map is used
+		 */
+		PackedPositionMapAdapter(const number capacity, const number logCapacity, const string filename = "", const bool override = true);
+
+		~PackedPositionMapAdapter() final;
+		number get(const number block) const final;
+		void set(const number block, const number leaf) final;
+	};
+
 	class ORAM;
 
 	/**
 	 * @brief A PathORAM implementation of the position map adapter.
 	 *
 	 * Uses an instance of PathORAM as the storage for the map.
+	 * Each ORAM block holds packing consecutive leaves (of sizeof(number) bytes),
+	 * and a remap (getAndSet) is a single ORAM access.
 	 */
 	class ORAMPositionMapAdapter : public AbsPositionMapAdapter
 	{
 		private:
 		const shared_ptr<ORAM> oram;
+		const number packing; // leaves per ORAM block
 
 		friend class ORAMBigTest;
 
@@ -98,10 +156,28 @@ namespace PathORAM
 		 * @brief Construct a new ORAMPositionMapAdapter object
 		 *
 		 * @param oram the intialized (with proper capacities) ORAM that will be used as a position map storage
+		 * @param packing the number of leaves per ORAM block (ORAM block size must be at least packing * sizeof(number))
 		 */
-		ORAMPositionMapAdapter(const shared_ptr<ORAM> oram);
+		ORAMPositionMapAdapter(const shared_ptr<ORAM> oram, const number packing = 1);
 		~ORAMPositionMapAdapter() final;
 		number get(const number block) const final;
 		void set(const number block, const number leaf) final;
+		number getAndSet(const number block, const number leaf) final;
+
+		/**
+		 * @brief creates a multi-level recursive position map sized automatically
+		 *
+		 * Each level is an in-memory ORAM whose blocks pack blockSize / sizeof(number) leaves of the level above,
+		 * so every level is that many times smaller than the previous one.
+		 * Recursion stops with an in-memory position map once a level has at most directLimit entries.
+		 *
+		 * @param capacity the number of entries (e.g. the number of blocks of the ORAM that will use the map)
+		 * @param blockSize the block size of the inner ORAMs (the larger, the fewer levels)
+		 * @param Z number of blocks in a bucket of the inner ORAMs
+		 * @param directLimit the max number of entries kept in a plain in-memory map
+		 * @param treeTopSize the tree-top cache budget in bytes of each inner ORAM
+		 * @return shared_ptr<AbsPositionMapAdapter> the position map
+		 */
+		static shared_ptr<AbsPositionMapAdapter> recursive(const number capacity, const number blockSize, const number Z, const number directLimit, const number treeTopSize = 0);
 	};
 }
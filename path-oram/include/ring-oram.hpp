@@ -0,0 +1,210 @@
+#pragma once
+
+#include "definitions.h"
+#include "position-map-adapter.hpp"
+#include "stash-adapter.hpp"
+#include "storage-adapter.hpp"
+#include "tree.hpp"
+
+#include <vector>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief RingORAM class (Ren et al., "Constants Count: Practical Improvements to Oblivious RAM")
+	 *
+	 * A drop-in alternative to ORAM with the same get / put / multiple / load API.
+	 * Each bucket has Z real and S reserved dummy slots in a random permutation;
+	 * an access reads only one slot per bucket (the requested block or a fresh dummy),
+	 * every A accesses a path is evicted in deterministic reverse-lexicographic order,
+	 * and a bucket read S times is reshuffled early.
+	 *
+	 * The storage adapter has to be created with Z = 1 (every slot is a separately encrypted storage location)
+	 * and capacity of at least 2^logCapacity * (Z + S) locations.
+	 * The bucket metadata (which block is in which slot, which slots are still valid) is kept by the client.
+	 *
+	 * Needs to be instantiated with adapters (storage, position map and stash).
+	 */
+	class RingORAM
+	{
+		private:
+		// client-side bucket metadata
+		struct Metadata
+		{
+			vector<number> ids; // block ID in each slot, ULONG_MAX for a dummy
+			vector<bool> valid; // whether the slot has not been read since the bucket was written
+			number count = 0;	// number of reads since the bucket was written
+		};
+
+		const shared_ptr<AbsStorageAdapter> storage;
+		const shared_ptr<AbsPositionMapAdapter> map;
+		const shared_ptr<AbsStashAdapter> stash;
+
+		const number dataSize; // size of the "usable" portion of the block in bytes
+		const number Z;		   // number of real slots per bucket
+		const number S;		   // number of reserved dummy slots per bucket
+		const number A;		   // eviction rate (a path is evicted every A accesses)
+
+		const number height;  // number of tree levels
+		const number buckets; // total number of buckets
+		const number blocks;  // total number of blocks
+		const Tree tree;	  // paths, levels and bucket locations
+
+		const number batchSize; // a max number of requests to process at a time (default 1)
+
+		number round	 = 0; // accesses since the last eviction
+		number evictions = 0; // number of evictions so far (defines the next eviction path)
+
+		vector<Metadata> metadata; // indexed by bucket location, 0 is unused
+
+		/**
+		 * @brief performs a single access, read or write
+		 *
+		 * @param read true of read access, false if write access
+		 * @param block the block ID requested
+		 * @param data if write, the data to be put in block (discarded if read)
+		 * @param response if read, the content of requested block (empty if write)
+		 */
+		void access(const bool read, const number block, const bytes &data, bytes &response);
+
+		/**
+		 * @brief reads one slot per bucket along the path: the block if it is there, or a valid dummy otherwise
+		 *
+		 * The read slots are invalidated, the block (if found) is put in stash.
+		 *
+		 * @param leaf the leaf that uniquely defines the path from root
+		 * @param block the block ID requested
+		 */
+		void readPath(const number leaf, const number block);
+
+		/**
+		 * @brief reads Z valid slots of each of the buckets (all the real ones, padded with dummies) and puts real blocks in stash
+		 *
+		 * @param leaf the leaf that defines the path
+		 * @param levels the levels of the buckets on the path to read
+		 */
+		void readBuckets(const number leaf, const vector<number> &levels);
+
+		/**
+		 * @brief rewrites the buckets with blocks from stash (deepest first), fresh dummies and fresh permutations
+		 *
+		 * @param leaf the leaf that defines the path
+		 * @param levels the levels of the buckets on the path to write
+		 */
+		void writeBuckets(const number leaf, const vector<number> &levels);
+
+		/**
+		 * @brief evicts the next path in reverse-lexicographic order (read all of its buckets, then rewrite them)
+		 */
+		void evictPath();
+
+		/**
+		 * @brief reads and rewrites the buckets on the path that have run out of valid dummies
+		 *
+		 * @param leaf the leaf that defines the path
+		 */
+		void earlyReshuffle(const number leaf);
+
+		/**
+		 * @brief puts the blocks in a fresh random permutation of Z + S slots
+		 *
+		 * The metadata is returned, not stored: the caller replaces the bucket metadata only once the slots are written.
+		 *
+		 * @param location the bucket location in the tree
+		 * @param reals up to Z real blocks
+		 * @param requests the storage SET requests to append to
+		 * @return Metadata the metadata of the new bucket
+		 */
+		Metadata permuteBucket(const number location, vector<block> &reals, vector<pair<const number, bucket>> &requests);
+
+		/**
+		 * @brief computes the location in the storage of a slot of a bucket
+		 */
+		number slotLocation(const number location, const number slot) const;
+
+		friend class RingORAMTest_OneSlotPerBucket_Test;
+		friend class RingORAMTest_EarlyReshuffle_Test;
+		friend class RingORAMTest_WriteError_Test;
+
+		public:
+		/**
+		 * @brief Construct a new RingORAM object given adapters
+		 *
+		 * @param logCapacity height of the tree or logarithm base 2 of capacity (i.e. capacity is 2 to the power of this value)
+		 * @param blockSize the size (user's portion) of ORAM block in bytes (must be at least 2 AES block sizes - at least 32 bytes)
+		 * @param Z number of real slots in a bucket (typically, 4 to 16)
+		 * @param S number of reserved dummy slots in a bucket (a bucket is reshuffled after S reads)
+		 * @param A eviction rate, a path is evicted every A accesses (typically, 2Z - 1 or less)
+		 * @param storage pointer to storage adapter to use (with Z = 1 and 2^logCapacity * (Z + S) capacity)
+		 * @param map pointer to position map adapter to use
+		 * @param stash pointer to stash adapter to use
+		 * @param batchSize controls the max number of requests in multiple(...)
+		 */
+		RingORAM(
+			const number logCapacity,
+			const number blockSize,
+			const number Z,
+			const number S,
+			const number A,
+			const shared_ptr<AbsStorageAdapter> storage,
+			const shared_ptr<AbsPositionMapAdapter> map,
+			const shared_ptr<AbsStashAdapter> stash,
+			const number batchSize = 1);
+
+		/**
+		 * @brief Construct a new RingORAM object with adapters created automatically
+		 *
+		 * The adapters are created with the following capcities:
+		 * CAPACITY = 2^logCapacity
+		 * 	in-memory storage: CAPACITY * (Z + S) slots
+		 * 	in-memory position map: CAPACITY * Z + Z
+		 * 	in-memory stash: 3 * Z * logCapacity
+		 *
+		 * @param logCapacity as in the extended constructor
+		 * @param blockSize as in the extended constructor
+		 * @param Z as in the extended constructor
+		 * @param S as in the extended constructor
+		 * @param A as in the extended constructor
+		 */
+		RingORAM(const number logCapacity, const number blockSize, const number Z, const number S, const number A);
+
+		/**
+		 * @brief Retrives a block from ORAM
+		 *
+		 * @param block block ID to request
+		 * @param response the (decrypted) data from the block
+		 */
+		void get(const number block, bytes &response);
+
+		/**
+		 * @brief Puts a block to ORAM
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block
+		 */
+		void put(const number block, const bytes &data);
+
+		/**
+		 * @brief processes multiple requests at a time
+		 *
+		 * The requests are executed one by one (each already reads its path in one batch).
+		 *
+		 * @param requests the sequence of requests in a form of {ID, payload}
+		 * If payload is empty (zero size), the requests is treated as GET, otherwise PUT.
+		 * @param response the answer to the requests, as in ORAM::multiple
+		 *
+		 * \note
+		 * The number fo request must not exceed the batchSize parameter used to construct the ORAM.
+		 */
+		void multiple(const vector<block> &requests, vector<bytes> &response);
+
+		/**
+		 * @brief bulk loads the data bypassing usual ORAM protocol, as ORAM::load
+		 *
+		 * @param data the data to bulk load
+		 */
+		void load(vector<block> &data);
+	};
+}
@@ -2,6 +2,7 @@
 
 #include "definitions.h"
 
+#include <functional>
 #include <iostream>
 #include <unordered_map>
 
@@ -33,6 +34,16 @@ namespace PathORAM
 		 */
 		virtual void add(const number block, const bytes &data) = 0;
 
+		/**
+		 * @brief put an object in the stash taking over its data
+		 *
+		 * Same as add above, but the data may be moved instead of copied (the default implementation copies).
+		 *
+		 * @param block ID of the block
+		 * @param data data part of the object (unspecified state after the call)
+		 */
+		virtual void add(const number block, bytes &&data);
+
 		/**
 		 * @brief change an object in the stash (by ID)
 		 *
@@ -52,6 +63,16 @@ namespace PathORAM
 		 */
 		virtual void get(const number block, bytes &response) const = 0;
 
+		/**
+		 * @brief retrieve the object by ID and remove it from the stash
+		 *
+		 * Same as get followed by deleteBlock, but the data may be moved out instead of copied (the default implementation copies).
+		 *
+		 * @param block ID of the block
+		 * @param response data part of the object (previous content is replaced), empty if the object does not exist
+		 */
+		virtual void take(const number block, bytes &response);
+
 		/**
 		 * @brief removes the object by ID
 		 *
@@ -61,6 +82,16 @@ namespace PathORAM
 		 */
 		virtual void deleteBlock(const number block) = 0;
 
+		/**
+		 * @brief visit all objects in the stash (in no particular order) without copying them
+		 *
+		 * The default implementation goes through getAll.
+		 * The visitor must not modify the stash.
+		 *
+		 * @param visitor receives ID, pointer to the data and its size (valid only during the call)
+		 */
+		virtual void forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const;
+
 		virtual ~AbsStashAdapter() = 0;
 
 		protected:
@@ -112,9 +143,12 @@ namespace PathORAM
 
 		void getAll(vector<block> &response) const final;
 		void add(const number block, const bytes &data) final;
+		void add(const number block, bytes &&data) final;
 		void update(const number block, const bytes &data) final;
 		void get(const number block, bytes &response) const final;
+		void take(const number block, bytes &response) final;
 		void deleteBlock(const number block) final;
+		void forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const final;
 
 		/**
 		 * @brief Returns the current size of the stash (in blocks)
@@ -138,4 +172,79 @@ namespace PathORAM
 		 */
 		void loadFromFile(const string filename, const int blockSize);
 	};
+
+	/**
+	 * @brief In-memory implementation of the stash adapter that does not allocate after construction
+	 *
+	 * Payloads live in a preallocated arena of capacity x blockSize bytes;
+	 * a fixed open-addressing table (linear probing, at least twice the capacity) maps block IDs to arena slots (handles).
+	 * Only get, take and getAll copy the payloads, eviction should use forEach.
+	 *
+	 * Unlike InMemoryStashAdapter, the capacity is a hard limit: inserting over it always throws.
+	 */
+	class FlatStashAdapter : public AbsStashAdapter
+	{
+		private:
+		const number capacity;
+		const number blockSize; // max size of the payload in bytes
+		const number shift;		// 64 minus log2 of the table size (for multiplicative hashing)
+		const number mask;		// table size minus one
+
+		vector<number> ids;		// block ID in each table slot, ULONG_MAX if empty
+		vector<number> handles; // arena slot for each table slot
+		vector<uchar> arena;	// payloads, blockSize bytes per arena slot
+		vector<number> sizes;	// payload size in each arena slot
+		vector<number> unused;	// stack of free arena slots
+
+		/**
+		 * @brief the table slot the block ID hashes to
+		 */
+		number home(const number block) const;
+
+		/**
+		 * @brief finds the table slot of the block
+		 *
+		 * @param block block ID in question
+		 * @return number the table slot or ULONG_MAX if the block is not in the stash
+		 */
+		number find(const number block) const;
+
+		/**
+		 * @brief inserts the block (if it is not in stash yet) and writes the payload
+		 *
+		 * @param block block ID of the block
+		 * @param data data part of the object
+		 * @param override whether to rewrite the payload of an existing block
+		 */
+		void put(const number block, const bytes &data, const bool override);
+
+		bool exists(const number block) const final;
+
+		public:
+		/**
+		 * @brief Construct a new Flat Stash Adapter object, allocates all memory it will use
+		 *
+		 * @param capacity the maximum number of objects in the stash
+		 * @param blockSize the maximum size of the data part of an object in bytes
+		 */
+		FlatStashAdapter(const number capacity, const number blockSize);
+
+		~FlatStashAdapter() final;
+
+		using AbsStashAdapter::add; // the payload is copied into the arena either way
+
+		void getAll(vector<block> &response) const final;
+		void add(const number block, const bytes &data) final;
+		void update(const number block, const bytes &data) final;
+		void get(const number block, bytes &response) const final;
+		void deleteBlock(const number block) final;
+		void forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const final;
+
+		/**
+		 * @brief Returns the current size of the stash (in blocks)
+		 *
+		 * @return number the current size of the stash (in blocks)
+		 */
+		number currentSize() const;
+	};
 }
@@ -1,13 +1,26 @@
 #pragma once
 
 #include "definitions.h"
+#include "utility.hpp"
 
 #include <boost/range/any_range.hpp>
 #include <boost/signals2/signal.hpp>
 #include <fstream>
 
 #if USE_REDIS
+#include <mutex>
 #include <sw/redis++/redis++.h>
+#include <thread>
+#include <unordered_map>
+#endif
+
+#if USE_IO_URING
+// linux/io_uring.h is only included in the source (it drags in macros like BLOCK_SIZE)
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// alignment of file offsets, lengths and buffers for O_DIRECT
+#define IO_URING_ALIGNMENT 4096
 #endif
 
 // #if USE_AEROSPIKE
@@ -67,14 +80,32 @@ namespace PathORAM
 		 */
 		void getAndRecord(const vector<number> &locations, vector<bytes> &response) const;
 
-		const bytes key;		 // AES key for encryption operations
-		const number Z;			 // number of blocks in a bucket
-		const number batchLimit; // maximum number of requests in a batch
+		/**
+		 * @brief Proxy for setInternal(vector<number> &locations, uchar *raw) that emits OnStorageRequest
+		 */
+		void setAndRecord(const vector<number> &locations, const uchar *raw);
+
+		/**
+		 * @brief Proxy for getInternal(vector<number> &locations, uchar *response) that emits OnStorageRequest
+		 */
+		void getAndRecord(const vector<number> &locations, uchar *response) const;
+
+		/**
+		 * @brief encrypts and writes the buckets of any range of {location, bucket} (implements both batch set)
+		 */
+		template <typename Range>
+		void setRange(const Range &requests);
+
+		const bytes key;						// AES key for encryption operations
+		const unique_ptr<CipherContext> cipher; // keyed once, encrypts and decrypts whole requests in place
+		const number Z;							// number of blocks in a bucket
+		const number batchLimit;				// maximum number of requests in a batch
 
 		// Event handler
 		OnStorageRequest onStorageRequest;
 
 		friend class StorageAdapterTest_GetSetInternal_Test;
+		friend class StorageAdapterTest_GetSetInternalContiguous_Test;
 		friend class MockStorage;
 
 		public:
@@ -130,6 +161,13 @@ namespace PathORAM
 		 */
 		void set(const request_anyrange requests);
 
+		/**
+		 * @brief writes the data in batch, same as above, but without the type-erased range
+		 *
+		 * @param requests locations and data requests (IDs and payloads) to write
+		 */
+		void set(const vector<pair<number, bucket>> &requests);
+
 		/**
 		 * @brief sets all available locations (given by CAPACITY) to zeroed bytes.
 		 * On the storage these zeroes will appear randomized encrypted.
@@ -146,6 +184,11 @@ namespace PathORAM
 		 */
 		virtual bool supportsBatchSet() const = 0;
 
+		/**
+		 * @brief whether a read and a write operation (on different locations) may run concurrently on this adapter.
+		 */
+		virtual bool supportsConcurrentGetSet() const { return false; };
+
 		/**
 		 * @brief Construct a new Abs Storage Adapter object
 		 *
@@ -203,17 +246,41 @@ namespace PathORAM
 		 * @param response this vector will be appended (back-inserted) with blocks of bytes in the order defined by locations
 		 */
 		virtual void getInternal(const vector<number> &locations, vector<bytes> &response) const;
+
+		/**
+		 * @brief batch version of setInternal that consumes a contiguous buffer
+		 *
+		 * The default implementation splits the buffer and delegates to setInternal(vector<pair<number, bytes>> &requests).
+		 *
+		 * @param locations sequence (ordered) of locations to write to
+		 * @param raw locations.size() * blockSize bytes, i-th location is taken at offset i * blockSize
+		 */
+		virtual void setInternal(const vector<number> &locations, const uchar *raw);
+
+		/**
+		 * @brief batch version of getInternal that fills a contiguous buffer (e.g. a whole path at once)
+		 *
+		 * The default implementation delegates to getInternal(vector<number> &locations, vector<bytes> &response) and copies.
+		 *
+		 * @param locations sequence (ordered) of locations to read from
+		 * @param response at least locations.size() * blockSize bytes, i-th location is written at offset i * blockSize
+		 */
+		virtual void getInternal(const vector<number> &locations, uchar *response) const;
 	};
 
 	/**
 	 * @brief In-memory implementation of the storage adapter.
 	 *
-	 * Uses a RAM array as the underlying storage.
+	 * Uses a single contiguous RAM slab as the underlying storage.
+	 * Buckets are laid out by location, each starting on a cache line boundary.
+	 * The slab is backed by anonymous pages with transparent huge pages requested.
 	 */
 	class InMemoryStorageAdapter : public AbsStorageAdapter
 	{
 		private:
-		uchar **const blocks;
+		const number stride;	 // distance between buckets in the slab (blockSize rounded up to a cache line)
+		const number slabSize;	 // size of the mapping in bytes
+		uchar *const blocks;	 // the slab, bucket at location i starts at blocks + i * stride
 
 		public:
 		InMemoryStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const number Z, const number batchLimit = 0);
@@ -223,8 +290,12 @@ namespace PathORAM
 		void setInternal(const number location, const bytes &raw) final;
 		void getInternal(const number location, bytes &reponse) const final;
 
-		bool supportsBatchGet() const final { return false; };
-		bool supportsBatchSet() const final { return false; };
+		void setInternal(const vector<number> &locations, const uchar *raw) final;
+		void getInternal(const vector<number> &locations, uchar *response) const final;
+
+		bool supportsBatchGet() const final { return true; };
+		bool supportsBatchSet() const final { return true; };
+		bool supportsConcurrentGetSet() const final { return true; };
 
 		friend class MockStorage;
 	};
@@ -266,6 +337,157 @@ namespace PathORAM
 		bool supportsBatchSet() const final { return false; };
 	};
 
+	/**
+	 * @brief Memory-mapped file system implementation of the storage adapter.
+	 *
+	 * Uses a binary file (same layout as FileSystemStorageAdapter) mapped into the address space.
+	 * Reads and writes are served straight from the mapping, no syscalls on the access path.
+	 */
+	class MappedFileSystemStorageAdapter : public AbsStorageAdapter
+	{
+		private:
+		int file;				// file descriptor of the backing file
+		uchar *mapping;			// the mapped file, bucket at location i starts at mapping + i * blockSize
+		const number mapSize;	// size of the mapping in bytes
+		const number syncEvery; // number of SET batches between asynchronous flushes (0 to only flush on destruction)
+		number pendingWrites = 0;
+
+		/**
+		 * @brief counts a SET batch and schedules an asynchronous flush of dirty pages if syncEvery is reached
+		 */
+		void recordWrite();
+
+		public:
+		/**
+		 * @brief Construct a new Mapped File System Storage Adapter object
+		 *
+		 * It is possible to persist the data.
+		 * If the file exists, instantiate with override = false, and the key equal to the one used before.
+		 * The file is compatible with FileSystemStorageAdapter.
+		 *
+		 * @param capacity the max number of blocks
+		 * @param userBlockSize the size of the user's portion of the block in bytes
+		 * @param key the AES key to use (may be empty to generate new random one)
+		 * @param filename the file path to use
+		 * @param override if true, the file will be created (or truncated) and filled with empty blocks, otherwise the existing file will be opened
+		 * @param Z the number of blocks in a bucket.
+		 * GET and SET will operate using Z.
+		 * @param batchLimit the maximum number of requests in a batch.
+		 * @param populate if true, the whole file is read into the page cache at construction (MAP_POPULATE)
+		 * @param syncEvery the number of SET batches after which dirty pages are flushed (msync, asynchronous).
+		 * Set to 0 to flush only on destruction.
+		 */
+		MappedFileSystemStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string filename, const bool override, const number Z, const number batchLimit = 0, const bool populate = false, const number syncEvery = 0);
+		~MappedFileSystemStorageAdapter() final;
+
+		protected:
+		void setInternal(const number location, const bytes &raw) final;
+		void getInternal(const number location, bytes &reponse) const final;
+
+		void setInternal(const vector<pair<number, bytes>> &requests) final;
+		void getInternal(const vector<number> &locations, vector<bytes> &response) const final;
+
+		void setInternal(const vector<number> &locations, const uchar *raw) final;
+		void getInternal(const vector<number> &locations, uchar *response) const final;
+
+		bool supportsBatchGet() const final { return true; };
+		bool supportsBatchSet() const final { return true; };
+		bool supportsConcurrentGetSet() const final { return true; };
+	};
+
+#if USE_IO_URING
+	/**
+	 * @brief io_uring implementation of the storage adapter.
+	 *
+	 * Uses a binary file accessed with O_DIRECT (when the file system supports it) through an io_uring instance.
+	 * A batch of buckets (e.g. a whole path) is submitted as one set of SQEs, so the device sees the full queue depth.
+	 * The I/O goes through a registered (fixed) staging buffer.
+	 *
+	 * \note
+	 * With O_DIRECT each bucket occupies a multiple of IO_URING_ALIGNMENT bytes in the file,
+	 * so the file is not compatible with FileSystemStorageAdapter.
+	 */
+	class IOUringStorageAdapter : public AbsStorageAdapter
+	{
+		private:
+		int file = -1;		   // file descriptor of the backing file
+		int ring = -1;		   // io_uring file descriptor
+		const number stride;   // distance between buckets in the file (and in the staging buffer)
+		number queueDepth;	   // maximum number of SQEs in flight
+		uchar *staging = nullptr; // registered buffer of queueDepth * stride bytes
+
+		// submission queue
+		void *sqRing = nullptr;
+		number sqRingSize;
+		io_uring_sqe *sqes = nullptr;
+		number sqesSize;
+		unsigned *sqTail;
+		unsigned *sqMask;
+		unsigned *sqArray;
+
+		// completion queue
+		void *cqRing = nullptr;
+		number cqRingSize;
+		unsigned *cqHead;
+		unsigned *cqTail;
+		unsigned *cqMask;
+		io_uring_cqe *cqes;
+
+		/**
+		 * @brief opens the file, sets up and maps the ring and registers the buffer (throws on failure)
+		 */
+		void initialize(const string &filename, const bool override, const bool direct);
+
+		/**
+		 * @brief unmaps and closes whatever has been set up (safe to call on a partially constructed object)
+		 */
+		void release();
+
+		/**
+		 * @brief submits one SQE per location and waits for all completions
+		 *
+		 * @param read true for IORING_OP_READ_FIXED, false for IORING_OP_WRITE_FIXED
+		 * @param first the first location to process
+		 * @param count the number of locations to process (at most queueDepth), i-th uses staging + i * stride
+		 */
+		void submit(const bool read, const number *first, const number count) const;
+
+		public:
+		/**
+		 * @brief Construct a new io_uring Storage Adapter object
+		 *
+		 * It is possible to persist the data.
+		 * If the file exists, instantiate with override = false, and the key equal to the one used before.
+		 *
+		 * @param capacity the max number of blocks
+		 * @param userBlockSize the size of the user's portion of the block in bytes
+		 * @param key the AES key to use (may be empty to generate new random one)
+		 * @param filename the file path to use
+		 * @param override if true, the file will be created (or truncated) and filled with empty blocks, otherwise the existing file will be opened
+		 * @param Z the number of blocks in a bucket.
+		 * GET and SET will operate using Z.
+		 * @param batchLimit the maximum number of requests in a batch.
+		 * @param queueDepth the number of requests submitted at a time (larger batches are split)
+		 * @param direct if true, the file is opened with O_DIRECT (silently falls back if the file system does not support it)
+		 */
+		IOUringStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string filename, const bool override, const number Z, const number batchLimit = 0, const number queueDepth = 64, const bool direct = true);
+		~IOUringStorageAdapter() final;
+
+		protected:
+		void setInternal(const number location, const bytes &raw) final;
+		void getInternal(const number location, bytes &reponse) const final;
+
+		void setInternal(const vector<pair<number, bytes>> &requests) final;
+		void getInternal(const vector<number> &locations, vector<bytes> &response) const final;
+
+		void setInternal(const vector<number> &locations, const uchar *raw) final;
+		void getInternal(const vector<number> &locations, uchar *response) const final;
+
+		bool supportsBatchGet() const final { return true; };
+		bool supportsBatchSet() const final { return true; };
+	};
+#endif
+
 #if USE_REDIS
 	/**
 	 * @brief Redis implementation of the storage adapter.
@@ -303,6 +525,78 @@ namespace PathORAM
 		void setInternal(const vector<pair<number, bytes>> &requests) final;
 		void getInternal(const vector<number> &locations, vector<bytes> &response) const final;
 
+		bool supportsBatchGet() const final { return true; };
+		bool supportsBatchSet() const final { return true; };
+		bool supportsConcurrentGetSet() const final { return true; };
+	};
+
+	/**
+	 * @brief Pipelined Redis implementation of the storage adapter.
+	 *
+	 * Compared to RedisStorageAdapter, keys are fixed-width binary (the location's 8 bytes),
+	 * connections come from a pool (one per concurrently accessing thread),
+	 * and SET requests are deferred: the pending MSET of a thread is sent in the same pipeline
+	 * (and before) the MGET of that thread's next GET request.
+	 * For ORAM this means the write-back of access i and the path read of access i+1 cost one round trip.
+	 *
+	 * \note
+	 * Deferred writes are visible to other threads and clients only after the writing thread's next GET,
+	 * an explicit flush() or the destruction of the adapter.
+	 */
+	class PipelinedRedisStorageAdapter : public AbsStorageAdapter
+	{
+		private:
+		const unique_ptr<sw::redis::Redis> redis;
+
+		// arguments {key, value} of one deferred MSET (one batch of SET requests)
+		using redis_writes = vector<pair<string, string>>;
+
+		// deferred MSETs of all threads, in the order of set calls;
+		// the lock is held until a round trip carrying them completes,
+		// so that no read (from any thread) can overtake a write that has been queued before it
+		mutable mutex pendingLock;
+		mutable vector<redis_writes> pending;
+
+		/**
+		 * @brief fixed-width binary Redis key for a location
+		 */
+		static string keyFor(const number location);
+
+		public:
+		/**
+		 * @brief Construct a new Pipelined Redis Storage Adapter object
+		 *
+		 * It is possible to persist the data.
+		 * If the file exists, instantiate with override = false, and the key equal to the one used before.
+		 *
+		 * @param capacity the max number of blocks
+		 * @param userBlockSize the size of the user's portion of the block in bytes
+		 * @param key the AES key to use (may be empty to generate new random one)
+		 * @param host the URL to the Redis cluster (will throw exception if ping on the URL fails)
+		 * @param override if true, the cluster will be flushed and filled with random blocks first
+		 * @param Z the number of blocks in a bucket.
+		 * GET and SET will operate using Z.
+		 * @param batchLimit the maximum number of requests in a batch.
+		 * @param poolSize the number of connections to keep open (the number of threads that can access Redis at once)
+		 */
+		PipelinedRedisStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string host, const bool override, const number Z, const number batchLimit = 300000, const number poolSize = 1);
+		~PipelinedRedisStorageAdapter() final;
+
+		/**
+		 * @brief sends the deferred writes (of all threads)
+		 */
+		void flush();
+
+		protected:
+		void setInternal(const number location, const bytes &raw) final;
+		void getInternal(const number location, bytes &reponse) const final;
+
+		void setInternal(const vector<pair<number, bytes>> &requests) final;
+		void getInternal(const vector<number> &locations, vector<bytes> &response) const final;
+
+		void setInternal(const vector<number> &locations, const uchar *raw) final;
+		void getInternal(const vector<number> &locations, uchar *response) const final;
+
 		bool supportsBatchGet() const final { return true; };
 		bool supportsBatchSet() const final { return true; };
 	};
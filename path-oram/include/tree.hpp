@@ -0,0 +1,98 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <functional>
+#include <vector>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	class AbsPositionMapAdapter;
+
+	/**
+	 * @brief Geometry of the tree of buckets shared by ORAM and RingORAM
+	 *
+	 * Buckets are numbered in heap order: the root is 1 and the children of x are 2x and 2x + 1.
+	 * Leaves are numbered from 0 to 2^(height - 1) - 1, a leaf uniquely defines the path from the root.
+	 */
+	class Tree
+	{
+		private:
+		const number height; // number of tree levels
+
+		public:
+		/**
+		 * @brief Construct a new Tree object
+		 *
+		 * @param height number of tree levels (logarithm base 2 of the number of buckets)
+		 */
+		Tree(const number height);
+
+		/**
+		 * @brief computes the i-th leaf in the reverse-lexicographic order (the leaf with bits of i reversed)
+		 *
+		 * Consecutive evictions are spread over the tree as far from each other as possible.
+		 *
+		 * @param i the number of the eviction
+		 * @return number the leaf
+		 */
+		number reverseLexicographicLeaf(const number i) const;
+
+		/**
+		 * @brief checks if the paths "merge" on the level
+		 *
+		 * @param pathLeaf leaf that defines the first path
+		 * @param blockPosition leaf that defines the second path
+		 * @param level level in question
+		 * @return true if the paths share the same node on the given level
+		 * @return false otherwise
+		 */
+		bool canInclude(const number pathLeaf, const number blockPosition, const number level) const;
+
+		/**
+		 * @brief computes the deepest level on which the paths share a node
+		 *
+		 * Two paths share all nodes above the highest bit in which their leaves differ (leaf XOR trick).
+		 *
+		 * @param pathLeaf leaf that defines the first path
+		 * @param blockPosition leaf that defines the second path
+		 * @return number the deepest shared level (root is 0, leaves are height - 1)
+		 */
+		number deepestCommonLevel(const number pathLeaf, const number blockPosition) const;
+
+		/**
+		 * @brief computes the location of a bucket (not block) in a given path on a given level
+		 *
+		 * @param level level in question
+		 * @param leaf leaf that defines the path in question
+		 * @return number the location of the requested bucket in the tree
+		 */
+		number bucketForLevelLeaf(const number level, const number leaf) const;
+
+		/**
+		 * @brief compute a range of possible leaves for the bucket
+		 *
+		 * @param location the bucket location in the tree
+		 * @return pair<number, number> {from, to} inclusive leaves that would satisfy the invariant
+		 */
+		pair<number, number> leavesForLocation(const number location) const;
+
+		/**
+		 * @brief places the data for a bulk load, bypassing usual ORAM protocol
+		 *
+		 * The data is shuffled (such bulk load may leak in part the original order)
+		 * and dispersed evenly over the buckets Z blocks at a time;
+		 * each block is mapped to a random leaf below its bucket.
+		 *
+		 * Throws exception if there are more than Z blocks per bucket.
+		 *
+		 * @param data the data to bulk load (will be shuffled)
+		 * @param Z the number of blocks per bucket
+		 * @param map the position map to record the leaves in
+		 * @param place receives the location of a bucket and up to Z blocks for it (only the last group may have fewer)
+		 */
+		void load(vector<block> &data, const number Z, AbsPositionMapAdapter &map, const function<void(const number location, vector<block> &blocks)> &place) const;
+	};
+}
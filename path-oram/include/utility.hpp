@@ -2,6 +2,7 @@
 
 #include "definitions.h"
 
+#include <openssl/evp.h>
 #include <string>
 
 namespace PathORAM
@@ -20,6 +21,18 @@ namespace PathORAM
 	 */
 	bytes getRandomBlock(const number blockSize);
 
+	/**
+	 * @brief fill the memory region with pseudorandom bytes (bulk version of getRandomBlock)
+	 *
+	 * \note
+	 * Outside of TESTING, requests smaller than RANDOM_BUFFER_SIZE are served from a per-thread buffer
+	 * refilled by OpenSSL PRG in RANDOM_BUFFER_SIZE chunks.
+	 *
+	 * @param output the region to fill
+	 * @param size the number of bytes to generate
+	 */
+	void fillRandom(uchar *output, const number size);
+
 	/**
 	 * @brief returns a pseudorandom number
 	 *
@@ -28,6 +41,15 @@ namespace PathORAM
 	 */
 	number getRandomULong(const number max);
 
+	/**
+	 * @brief returns count pseudorandom numbers (bulk version of getRandomULong)
+	 *
+	 * @param max the non-inclusive max of the range (min is inclusive 0).
+	 * @param count the number of numbers to generate
+	 * @param output the vector to append the numbers to
+	 */
+	void getRandomULongs(const number max, const number count, vector<number> &output);
+
 	/**
 	 * @brief returns a pseudorandom double
 	 *
@@ -71,6 +93,66 @@ namespace PathORAM
 		bytes &output,
 		const EncryptionMode mode);
 
+	/**
+	 * @brief Reusable encryption context
+	 *
+	 * Holds OpenSSL EVP contexts keyed once (key schedule is computed on first use of a mode and direction),
+	 * so that repeated operations only reset the IV.
+	 * Operations are in place over caller-provided memory.
+	 * The MODE is configured with global setting __blockCipherMode (currently CBC or CTR), same as for encrypt.
+	 *
+	 * \note
+	 * The context is stateful and not thread-safe; use one per thread (or per storage adapter).
+	 */
+	class CipherContext
+	{
+		private:
+		const bytes key;
+
+		// [CBC, CTR] x [ENCRYPT, DECRYPT], both CTR ones are keyed for encryption;
+		// an encryption and a decryption never share a context, so they may run concurrently
+		EVP_CIPHER_CTX *contexts[2][2] = {{nullptr, nullptr}, {nullptr, nullptr}};
+
+		/**
+		 * @brief returns the context for the current __blockCipherMode and the direction, keying it if necessary
+		 */
+		EVP_CIPHER_CTX *context(const EncryptionMode mode);
+
+		public:
+		/**
+		 * @brief Construct a new Cipher Context object
+		 *
+		 * @param key the AES key (must be KEYSIZE bytes)
+		 */
+		explicit CipherContext(const bytes &key);
+		~CipherContext();
+
+		CipherContext(const CipherContext &) = delete;
+		CipherContext &operator=(const CipherContext &) = delete;
+
+		/**
+		 * @brief encrypts or decrypts the memory region in place
+		 *
+		 * @param iv the initialization vector (AES block size, 16 bytes)
+		 * @param data the region to transform
+		 * @param size the size of the region, must be the multiple of AES block size (16 bytes)
+		 * @param mode ENCRYPTION or DECRYPTION
+		 */
+		void crypt(const uchar *iv, uchar *data, const number size, const EncryptionMode mode);
+
+		/**
+		 * @brief encrypts or decrypts a sequence of records in place (e.g. all buckets of a path)
+		 *
+		 * Each record is stride bytes long, first AES block size bytes are its IV, the rest is transformed.
+		 *
+		 * @param buffer the first record
+		 * @param count the number of records
+		 * @param stride the size of a record (IV included)
+		 * @param mode ENCRYPTION or DECRYPTION
+		 */
+		void crypt(uchar *buffer, const number count, const number stride, const EncryptionMode mode);
+	};
+
 	/**
 	 * @brief helper to convert string to bytes and pad (from right with zeros)
 	 *
@@ -123,4 +205,29 @@ namespace PathORAM
 	 * @return number the hash of the message as a number [0, max)
 	 */
 	number hashToNumber(const bytes &input, number max);
+
+	/**
+	 * @brief record a message in the in-memory trace ring buffer (use TRACE macro instead)
+	 *
+	 * Keeps the latest TRACE_BUFFER_SIZE messages, thread-safe.
+	 *
+	 * @param level the trace level of the message (TRACE_ERROR ... TRACE_ACCESS)
+	 * @param message the message
+	 */
+	void traceMessage(const int level, const string &message);
+
+	/**
+	 * @brief record a formatted message in the in-memory trace ring buffer (use TRACE macro instead)
+	 *
+	 * @param level the trace level of the message (TRACE_ERROR ... TRACE_ACCESS)
+	 * @param message the message
+	 */
+	void traceMessage(const int level, const boost::format &message);
+
+	/**
+	 * @brief read the trace ring buffer
+	 *
+	 * @param output the vector to append the recorded messages to (oldest first)
+	 */
+	void getTrace(vector<string> &output);
 }
@@ -2,7 +2,9 @@
 
 #include "utility.hpp"
 
+#include <algorithm>
 #include <boost/format.hpp>
+#include <climits>
 
 namespace PathORAM
 {
@@ -17,7 +19,10 @@ namespace PathORAM
 		const shared_ptr<AbsPositionMapAdapter> map,
 		const shared_ptr<AbsStashAdapter> stash,
 		const bool initialize,
-		const number batchSize) :
+		const number batchSize,
+		const number treeTopSize,
+		const number evictionRate,
+		const number writeBackLimit) :
 		storage(storage),
 		map(map),
 		stash(stash),
@@ -26,7 +31,12 @@ namespace PathORAM
 		height(logCapacity),
 		buckets((number)1 << logCapacity),
 		blocks(((number)1 << logCapacity) * Z),
-		batchSize(batchSize)
+		tree(logCapacity),
+		batchSize(batchSize),
+		cache(logCapacity),
+		treeTopLevels(levelsForTreeTop(treeTopSize, logCapacity, Z, blockSize)),
+		evictionRate(evictionRate),
+		writeBackLimit(writeBackLimit)
 	{
 		if (initialize)
 		{
@@ -34,11 +44,55 @@ namespace PathORAM
 			storage->fillWithZeroes();
 
 			// generate random position map
+			vector<number> leaves;
+			getRandomULongs(1 << (height - 1), blocks, leaves);
 			for (number i = 0; i < blocks; ++i)
 			{
-				map->set(i, getRandomULong(1 << (height - 1)));
+				map->set(i, leaves[i]);
 			}
 		}
+
+		loadTreeTop();
+
+		if (writeBackLimit > 0)
+		{
+			writer = thread(&ORAM::writeBack, this);
+		}
+	}
+
+	ORAM::~ORAM()
+	{
+		if (writer.joinable())
+		{
+			{
+				lock_guard<mutex> guard(pendingLock);
+				stopping = true;
+			}
+			pendingChanged.notify_all();
+			writer.join();
+		}
+
+		if (treeTopLevels == 0)
+		{
+			return;
+		}
+
+		vector<pair<const number, bucket>> requests;
+		requests.reserve(treeTop.size() - 1);
+		for (auto location = 1uLL; location < treeTop.size(); location++)
+		{
+			requests.push_back({location, treeTop[location]});
+		}
+
+		try
+		{
+			auto guard = lockStorage();
+			storage->set(boost::make_iterator_range(requests.begin(), requests.end()));
+		}
+		catch (...)
+		{
+			// destructor must not throw; the storage is gone, so is the tree top
+		}
 	}
 
 	ORAM::ORAM(const number logCapacity, const number blockSize, const number Z) :
@@ -54,14 +108,33 @@ namespace PathORAM
 	void ORAM::get(const number block, bytes &response)
 	{
 		bytes data;
-		access(true, block, data, response);
+		guardCache([&]() { access(true, block, data, response); });
 		syncCache();
 	}
 
 	void ORAM::put(const number block, const bytes &data)
 	{
 		bytes response;
-		access(false, block, data, response);
+		guardCache([&]() { access(false, block, data, response); });
+		syncCache();
+	}
+
+	void ORAM::update(const number block, const function<void(bytes &)> &modifier, bytes &response)
+	{
+		TRACE(TRACE_ACCESS, boost::format("update block %1%") % block);
+
+		const auto previousPosition = map->getAndSet(block, getRandomULong(1 << (height - 1)));
+
+		guardCache([&]() {
+			fetchBlock(previousPosition, block);
+
+			stash->get(block, response);
+			auto data = response;
+			modifier(data);
+			stash->update(block, data);
+
+			evictAfterAccess(previousPosition);
+		});
 		syncCache();
 	}
 
@@ -72,97 +145,178 @@ namespace PathORAM
 		{
 			throw Exception(boost::format("Too many requests (%1%) for batch size %2%") % requests.size() % batchSize);
 		}
+		checkBlocks(requests);
 #endif
 
-		// populate cache
+		// step 1 from paper for the whole batch: remap each distinct block once,
+		// a duplicate reads a fresh random path, as its own access would
+		unordered_map<number, number> leaves; // new leaves of the requested blocks
 		unordered_set<number> locations;
 		for (auto &&request : requests)
 		{
-			readPath(map->get(request.first), locations, false);
+			const auto leaf = getRandomULong(1 << (height - 1));
+			if (leaves.count(request.first) == 0)
+			{
+				readPath(map->getAndSet(request.first, leaf), locations, false);
+				leaves[request.first] = leaf;
+			}
+			else
+			{
+				readPath(leaf, locations, false);
+			}
 		}
 
-		vector<block> cacheResponse;
-		getCache(locations, cacheResponse, true);
+		guardCache([&]() {
+			// step 2: read the union of paths once,
+			// the blocks are kept aside (the union may hold more than stash capacity)
+			vector<block> blocks, fetched;
+			getCache(locations, blocks, false);
+			unordered_map<number, number> fetchedIndex; // block ID -> index in fetched
+			for (auto &&entry : blocks)
+			{
+				// skip "empty" buckets
+				if (entry.first != ULONG_MAX)
+				{
+					fetchedIndex[entry.first] = fetched.size();
+					fetched.push_back(move(entry));
+				}
+			}
 
-		// run ORAM protocol (will use cache)
-		response.resize(requests.size());
-		for (auto i = 0u; i < requests.size(); i++)
-		{
-			access(requests[i].second.size() == 0, requests[i].first, requests[i].second, response[i]);
-		}
+			// step 3: serve the requests in order (from the fetched blocks or the stash)
+			response.resize(requests.size());
+			for (auto i = 0u; i < requests.size(); i++)
+			{
+				const auto write = requests[i].second.size() != 0;
+				const auto found = fetchedIndex.find(requests[i].first);
+				if (found != fetchedIndex.end())
+				{
+					auto &data = fetched[(*found).second].second;
+					if (write)
+					{
+						data = requests[i].second;
+					}
+					response[i] = data;
+				}
+				else
+				{
+					if (write)
+					{
+						stash->update(requests[i].first, requests[i].second);
+					}
+					stash->get(requests[i].first, response[i]);
+				}
+			}
 
-		// upload resulting new data
+			// step 4: evict along all paths at once and upload resulting new data
+			writePaths(locations, leaves, fetched);
+		});
 		syncCache();
 	}
 
-	void ORAM::load(vector<block> &data)
+	void ORAM::pipeline(const vector<block> &requests, vector<bytes> &response)
 	{
-		const number maxLocation = 1 << height;
-		const auto bucketCount	 = (data.size() + Z - 1) / Z; // for rounding errors
-		const auto step			 = maxLocation / (long double)bucketCount;
+#if INPUT_CHECKS
+		checkBlocks(requests);
+#endif
 
-		if (bucketCount > maxLocation)
+		response.resize(requests.size());
+		if (requests.size() == 0)
 		{
-			throw Exception("bulk load: too much data for ORAM");
+			return;
 		}
 
-		vector<pair<const number, bucket>> writeRequests;
-		writeRequests.reserve(bucketCount);
+		// step 1 from paper for the first request, its path is downloaded right away
+		auto leaf = map->getAndSet(requests[0].first, getRandomULong(1 << (height - 1)));
+		unordered_set<number> path;
+		readPath(leaf, path, false);
+		auto prefetched = prefetchPath(path);
 
-		// shuffle (such bulk load may leak in part the original order)
-		const uint n = data.size();
-		if (n >= 2)
+		for (auto i = 0u; i < requests.size(); i++)
 		{
-			// Fisher-Yates shuffle
-			for (uint i = 0; i < n - 1; i++)
+			TRACE(TRACE_ACCESS, boost::format("pipelined %1% block %2%") % (requests[i].second.size() == 0 ? "get" : "put") % requests[i].first);
+
+			guardCache([&]() {
+				// step 2: the buckets shared with the previous path are in the cache (and newer), the rest are prefetched
+				for (auto &&entry : prefetched.get())
+				{
+					cache[entry.first] = move(entry.second);
+				}
+				fetchBlock(leaf, requests[i].first); // stash updated
+
+				// step 3
+				if (requests[i].second.size() != 0) // if "write"
+				{
+					stash->update(requests[i].first, requests[i].second);
+				}
+				stash->get(requests[i].first, response[i]);
+
+				// step 4
+				evictAfterAccess(leaf); // stash updated
+			});
+
+			if (i + 1 == requests.size())
 			{
-				uint j = i + getRandomUInt(n - i);
-				swap(data[i], data[j]);
+				syncCache();
+				break;
 			}
+
+			// step 1 for the next request: start downloading its path, then write back the current one
+			leaf = map->getAndSet(requests[i + 1].first, getRandomULong(1 << (height - 1)));
+			unordered_set<number> next;
+			readPath(leaf, next, false);
+			prefetched = prefetchPath(next);
+
+			syncCache(next);
 		}
+	}
 
-		auto iteration = 0uLL;
-		bucket bucket;
-		for (auto &&record : data)
+	void ORAM::checkBlocks(const vector<block> &requests) const
+	{
+		// all requests are checked before any block is remapped, otherwise a failing request would lose the blocks remapped before it
+		for (auto &&request : requests)
 		{
-			// to disperse locations evenly from 1 to maxLocation
-			const auto location	  = (number)floor(1 + iteration * step);
-			const auto [from, to] = leavesForLocation(location);
-			map->set(record.first, getRandomULong(to - from + 1) + from);
-
-			if (bucket.size() < Z)
+			if (request.first >= blocks)
 			{
-				bucket.push_back(record);
-			}
-			if (bucket.size() == Z)
-			{
-				writeRequests.push_back({location, bucket});
-				iteration++;
-				bucket.clear();
+				throw Exception(boost::format("block %1% out of bound (capacity %2%)") % request.first % blocks);
 			}
 		}
-		const auto location = (number)floor(1 + iteration * step);
-		if (bucket.size() > 0)
-		{
-			for (auto i = 0u; i < bucket.size() - Z; i++)
+	}
+
+	void ORAM::load(vector<block> &data)
+	{
+		vector<pair<const number, bucket>> writeRequests;
+		writeRequests.reserve((data.size() + Z - 1) / Z);
+
+		tree.load(data, Z, *map, [this, &writeRequests](const number location, vector<block> &blocks) {
+			// the last bucket may be incomplete
+			bucket bucket(move(blocks));
+			while (bucket.size() < Z)
 			{
 				bucket.push_back({ULONG_MAX, bytes()});
 			}
-			writeRequests.push_back({location, bucket});
+			writeRequests.push_back({location, move(bucket)});
+		});
+
+		// pending write-backs must not overwrite the loaded data
+		flushWriteBack();
+		{
+			auto guard = lockStorage();
+			storage->set(boost::make_iterator_range(writeRequests.begin(), writeRequests.end()));
 		}
 
-		storage->set(boost::make_iterator_range(writeRequests.begin(), writeRequests.end()));
+		// bulk load went straight to the storage
+		loadTreeTop();
 	}
 
 	void ORAM::access(const bool read, const number block, const bytes &data, bytes &response)
 	{
+		TRACE(TRACE_ACCESS, boost::format("%1% block %2%") % (read ? "get" : "put") % block);
+
 		// step 1 from paper: remap block
-		const auto previousPosition = map->get(block);
-		map->set(block, getRandomULong(1 << (height - 1)));
+		const auto previousPosition = map->getAndSet(block, getRandomULong(1 << (height - 1)));
 
 		// step 2 from paper: read path
-		unordered_set<number> path;
-		readPath(previousPosition, path, true); // stash updated
+		fetchBlock(previousPosition, block); // stash updated
 
 		// step 3 from paper: update block
 		if (!read) // if "write"
@@ -172,7 +326,55 @@ namespace PathORAM
 		stash->get(block, response);
 
 		// step 4 from paper: write path
-		writePath(previousPosition); // stash updated
+		evictAfterAccess(previousPosition); // stash updated
+	}
+
+	void ORAM::fetchBlock(const number leaf, const number block)
+	{
+		unordered_set<number> path;
+		if (evictionRate == 0)
+		{
+			readPath(leaf, path, true);
+			return;
+		}
+
+		// download the path to the cache, it will be written back re-encrypted
+		readPath(leaf, path, false);
+		vector<pair<number, bytes>> dryRun;
+		getCache(path, dryRun, true);
+
+		for (auto &&location : path)
+		{
+			for (auto &&entry : inTreeTop(location) ? treeTop[location] : cache[location])
+			{
+				if (entry.first == block)
+				{
+					stash->add(entry.first, move(entry.second));
+					entry = {ULONG_MAX, getRandomBlock(dataSize)};
+				}
+			}
+		}
+	}
+
+	void ORAM::evictAfterAccess(const number leaf)
+	{
+		if (evictionRate == 0)
+		{
+			writePath(leaf);
+			return;
+		}
+
+		if (++accesses == evictionRate)
+		{
+			accesses = 0;
+
+			const auto evicted = tree.reverseLexicographicLeaf(evictions++);
+			TRACE(TRACE_ACCESS, boost::format("evict path %1%") % evicted);
+
+			unordered_set<number> path;
+			readPath(evicted, path, true);
+			writePath(evicted);
+		}
 	}
 
 	void ORAM::readPath(const number leaf, unordered_set<number> &path, const bool putInStash)
@@ -180,7 +382,7 @@ namespace PathORAM
 		// for levels from root to leaf
 		for (number level = 0; level < height; level++)
 		{
-			const auto bucket = bucketForLevelLeaf(level, leaf);
+			const auto bucket = tree.bucketForLevelLeaf(level, leaf);
 			path.insert(bucket);
 		}
 
@@ -195,7 +397,7 @@ namespace PathORAM
 				// skip "empty" buckets
 				if (id != ULONG_MAX)
 				{
-					stash->add(id, data);
+					stash->add(id, move(data));
 				}
 			}
 		}
@@ -203,57 +405,126 @@ namespace PathORAM
 
 	void ORAM::writePath(const number leaf)
 	{
-		vector<block> currentStash;
-		stash->getAll(currentStash);
+		// only IDs are collected, payloads are moved out of stash for the blocks that get placed
+		vector<number> stashed;
+		stash->forEach([&stashed](const number block, const uchar *, const number) { stashed.push_back(block); });
+
+		// one position map lookup per stash block: the deepest level on this path it may go to
+		vector<vector<number>> byLevel(height); // stash block IDs grouped by their deepest level
+		for (auto &&id : stashed)
+		{
+			byLevel[tree.deepestCommonLevel(leaf, map->get(id))].push_back(id);
+		}
 
-		vector<int> toDelete;				   // rember the records that will need to be deleted from stash
 		vector<pair<number, bucket>> requests; // storage SET requests (batching)
+		requests.reserve(height);
 
-		// following the path from leaf to root (greedy)
+		// following the path from leaf to root (greedy),
+		// blocks that did not fit deeper stay candidates for the levels above
+		vector<number> candidates;
 		for (int level = height - 1; level >= 0; level--)
 		{
-			vector<block> toInsert;		  // block to be insterted in the bucket (up to Z)
-			vector<number> toDeleteLocal; // same blocks needs to be deleted from stash (these hold indices of elements in currentStash)
+			candidates.insert(candidates.end(), byLevel[level].begin(), byLevel[level].end());
+
+			bucket bucket;
+			bucket.resize(Z);
 
-			for (number i = 0; i < currentStash.size(); i++)
+			// write the bucket
+			for (number i = 0; i < Z; i++)
 			{
-				const auto &entry	 = currentStash[i];
-				const auto entryLeaf = map->get(entry.first);
-				// see if this block from stash fits in this bucket
-				if (canInclude(entryLeaf, leaf, level))
+				if (candidates.size() != 0)
 				{
-					toInsert.push_back(entry);
-					toDelete.push_back(entry.first);
+					const auto id = candidates.back();
+					candidates.pop_back();
 
-					toDeleteLocal.push_back(i);
+					bucket[i].first = id;
+					stash->take(id, bucket[i].second);
+				}
+				else
+				{
+					// if nothing to insert, insert dummy (for security)
+					bucket[i] = {ULONG_MAX, getRandomBlock(dataSize)};
+				}
+			}
 
-					// look up to Z
-					if (toInsert.size() == Z)
-					{
-						break;
-					}
+			requests.push_back({tree.bucketForLevelLeaf(level, leaf), move(bucket)});
+		}
+
+		setCache(move(requests));
+	}
+
+	void ORAM::writePaths(const unordered_set<number> &locations, const unordered_map<number, number> &knownLeaves, vector<block> &fetched)
+	{
+		// only IDs are collected from stash, payloads are moved out of stash for the blocks that get placed
+		vector<number> ids;
+		stash->forEach([&ids](const number block, const uchar *, const number) { ids.push_back(block); });
+
+		// blocks at indices below stashed come from stash, the rest are fetched
+		const auto stashed = ids.size();
+		const auto total   = stashed + fetched.size();
+		for (auto &&entry : fetched)
+		{
+			ids.push_back(entry.first);
+		}
+
+		// indices of blocks grouped by the deepest bucket of the union they may go to
+		unordered_map<number, vector<number>> byLocation;
+		for (number i = 0; i < total; i++)
+		{
+			const auto known = knownLeaves.find(ids[i]);
+			const auto leaf	 = known != knownLeaves.end() ? (*known).second : map->get(ids[i]);
+
+			for (int level = height - 1; level >= 0; level--)
+			{
+				const auto location = tree.bucketForLevelLeaf(level, leaf);
+				if (locations.count(location) > 0)
+				{
+					byLocation[location].push_back(i);
+					break;
 				}
 			}
-			// delete inserted blocks from local stash
-			// we remove elements by location, so after operation vector shrinks (nasty bug...)
-			sort(toDeleteLocal.begin(), toDeleteLocal.end(), greater<number>());
-			for (auto &&removed : toDeleteLocal)
+		}
+
+		// a deeper level has greater locations, and children (2x, 2x + 1) come before the parent (x)
+		vector<number> ordered(locations.begin(), locations.end());
+		sort(ordered.begin(), ordered.end(), greater<number>());
+
+		vector<bool> placed(total, false);
+		vector<pair<number, bucket>> requests; // storage SET requests (batching)
+		requests.reserve(ordered.size());
+
+		unordered_map<number, vector<number>> carried; // blocks that did not fit in the children, by parent location
+		for (auto &&location : ordered)
+		{
+			auto &candidates = byLocation[location];
+			const auto fromChildren = carried.find(location);
+			if (fromChildren != carried.end())
 			{
-				currentStash.erase(currentStash.begin() + removed);
+				candidates.insert(candidates.end(), (*fromChildren).second.begin(), (*fromChildren).second.end());
+				carried.erase(fromChildren);
 			}
 
-			const auto bucketId = bucketForLevelLeaf(level, leaf);
 			bucket bucket;
 			bucket.resize(Z);
 
 			// write the bucket
 			for (number i = 0; i < Z; i++)
 			{
-				// auto block = bucket * Z + i;
-				if (toInsert.size() != 0)
+				if (candidates.size() != 0)
 				{
-					bucket[i] = toInsert.back();
-					toInsert.pop_back();
+					const auto index = candidates.back();
+					candidates.pop_back();
+
+					placed[index]	= true;
+					bucket[i].first = ids[index];
+					if (index < stashed)
+					{
+						stash->take(ids[index], bucket[i].second);
+					}
+					else
+					{
+						bucket[i].second = move(fetched[index - stashed].second);
+					}
 				}
 				else
 				{
@@ -262,35 +533,70 @@ namespace PathORAM
 				}
 			}
 
-			requests.push_back({bucketId, bucket});
+			// the rest stays in stash if this is the root
+			if (location > 1 && candidates.size() > 0)
+			{
+				auto &parent = carried[location / 2];
+				parent.insert(parent.end(), candidates.begin(), candidates.end());
+			}
+
+			requests.push_back({location, move(bucket)});
 		}
 
-		setCache(requests);
+		setCache(move(requests));
 
-		// update the stash adapter, remove newly inserted blocks
-		for (auto &&removed : toDelete)
+		// update the stash adapter, keep fetched blocks that did not fit
+		for (number i = stashed; i < total; i++)
 		{
-			stash->deleteBlock(removed);
+			if (!placed[i])
+			{
+				stash->add(ids[i], move(fetched[i - stashed].second));
+			}
 		}
 	}
 
-	number ORAM::bucketForLevelLeaf(const number level, const number leaf) const
+	number ORAM::levelsForTreeTop(const number treeTopSize, const number height, const number Z, const number dataSize)
 	{
-		std::cout << "leaf: " << leaf << " height: " << height << " level: " << level << std::endl;
-		return (leaf + (1 << (height - 1))) >> (height - 1 - level);
+		const auto bucketSize = Z * (sizeof(number) + dataSize);
+
+		// levels 0 to k - 1 hold 2^k - 1 buckets
+		auto levels = 0uLL;
+		while (levels < height && (((number)1 << (levels + 1)) - 1) * bucketSize <= treeTopSize)
+		{
+			levels++;
+		}
+		return levels;
 	}
 
-	bool ORAM::canInclude(const number pathLeaf, const number blockPosition, const number level) const
+	bool ORAM::inTreeTop(const number location) const
 	{
-		// on this level, do these paths share the same bucket
-		return bucketForLevelLeaf(level, pathLeaf) == bucketForLevelLeaf(level, blockPosition);
+		return location < ((number)1 << treeTopLevels);
 	}
 
-	pair<number, number> ORAM::leavesForLocation(const number location)
+	void ORAM::loadTreeTop()
 	{
-		const auto level	= (number)floor(log2(location));
-		const auto toLeaves = height - level - 1;
-		return {location * (1 << toLeaves) - (1 << (height - 1)), (location + 1) * (1 << toLeaves) - 1 - (1 << (height - 1))};
+		if (treeTopLevels == 0)
+		{
+			return;
+		}
+
+		vector<number> locations;
+		for (auto location = 1uLL; location < ((number)1 << treeTopLevels); location++)
+		{
+			locations.push_back(location);
+		}
+
+		vector<block> downloaded;
+		{
+			auto guard = lockStorage();
+			storage->get(locations, downloaded);
+		}
+
+		treeTop.assign(locations.size() + 1, bucket());
+		for (auto i = 0uLL; i < downloaded.size(); i++)
+		{
+			treeTop[locations[i / Z]].push_back(move(downloaded[i]));
+		}
 	}
 
 	void ORAM::getCache(const unordered_set<number> &locations, vector<block> &response, const bool dryRun)
@@ -299,53 +605,532 @@ namespace PathORAM
 		vector<number> toGet;
 		for (auto &&location : locations)
 		{
-			const auto bucketIt = cache.find(location);
-			if (bucketIt == cache.end())
+			if (inTreeTop(location))
+			{
+				if (!dryRun)
+				{
+					// the tree top is the only copy of these buckets, so they are copied, not moved
+					response.insert(response.end(), treeTop[location].begin(), treeTop[location].end());
+				}
+				continue;
+			}
+
+			const auto cached = cache.find(location);
+			if (cached == nullptr)
 			{
 				toGet.push_back(location);
 			}
 			else if (!dryRun)
 			{
-				response.insert(response.begin(), (*bucketIt).second.begin(), (*bucketIt).second.end());
+				move(cached->begin(), cached->end(), back_inserter(response));
 			}
 		}
 
+		// those in flight are taken from the latest pending write-back
+		takePending(toGet, response, dryRun);
+
 		if (toGet.size() > 0)
 		{
 			// download those blocks
 			vector<block> downloaded;
-			storage->get(toGet, downloaded);
+			{
+				auto guard = lockStorage();
+				storage->get(toGet, downloaded);
+			}
 
-			// add them to the cache and the result
-			bucket bucket;
+			// add them to the cache or (payloads only) to the result
 			for (auto i = 0uLL; i < downloaded.size(); i++)
 			{
-				if (!dryRun)
+				auto &bucket = cache[toGet[i / Z]];
+				if (dryRun)
 				{
-					response.push_back(downloaded[i]);
+					bucket.push_back(move(downloaded[i]));
 				}
-				bucket.push_back(downloaded[i]);
-				if (i % Z == Z - 1)
+				else
 				{
-					cache[toGet[i / Z]] = bucket;
-					bucket.clear();
+					bucket.push_back({downloaded[i].first, bytes()});
+					response.push_back(move(downloaded[i]));
 				}
 			}
 		}
 	}
 
-	void ORAM::setCache(const vector<pair<number, bucket>> &requests)
+	void ORAM::guardCache(const function<void()> &steps)
+	{
+		try
+		{
+			steps();
+		}
+		catch (...)
+		{
+			// the cached buckets of a path may hold IDs without payloads, they must not be uploaded;
+			// the storage and the pending write-backs still have their previous versions
+			cache.clear();
+			throw;
+		}
+	}
+
+	void ORAM::setCache(vector<pair<number, bucket>> &&requests)
 	{
 		for (auto &&request : requests)
 		{
-			cache[request.first] = request.second;
+			if (inTreeTop(request.first))
+			{
+				treeTop[request.first] = move(request.second);
+			}
+			else
+			{
+				cache[request.first] = move(request.second);
+			}
 		}
 	}
 
-	void ORAM::syncCache()
+	void ORAM::syncCache(const unordered_set<number> &keep)
 	{
-		storage->set(boost::make_iterator_range(cache.begin(), cache.end()));
+		vector<pair<number, bucket>> kept;
+
+		if (writeBackLimit == 0)
+		{
+			{
+				auto guard = lockStorage();
+				storage->set(cache.all());
+			}
 
-		cache.clear();
+			// uploaded, so the kept buckets may be moved out
+			for (auto &&location : keep)
+			{
+				const auto cached = cache.find(location);
+				if (cached != nullptr)
+				{
+					kept.push_back({location, move(*cached)});
+				}
+			}
+			cache.clear();
+		}
+		else
+		{
+			// the cache goes to the write-back queue as a whole, the kept buckets are copied
+			for (auto &&location : keep)
+			{
+				const auto cached = cache.find(location);
+				if (cached != nullptr)
+				{
+					kept.push_back({location, *cached});
+				}
+			}
+
+			unique_lock<mutex> lock(pendingLock);
+
+			// bounded: wait for the oldest write-back if too many are in flight (a failed one does not leave the queue)
+			pendingChanged.wait(lock, [this] { return writeBackError || pending.size() < writeBackLimit; });
+			rethrowWriteBackError();
+
+			pending.push_back(exchange(cache, BucketCache(height)));
+			pendingChanged.notify_all();
+		}
+
+		for (auto &&[location, bucket] : kept)
+		{
+			cache[location] = move(bucket);
+		}
+	}
+
+	unique_lock<mutex> ORAM::lockStorage()
+	{
+		return storage->supportsConcurrentGetSet() ? unique_lock<mutex>(storageLock, defer_lock) : unique_lock<mutex>(storageLock);
+	}
+
+	void ORAM::takePending(vector<number> &locations, vector<block> &response, const bool dryRun)
+	{
+		if (locations.size() == 0 || writeBackLimit == 0)
+		{
+			return;
+		}
+
+		lock_guard<mutex> guard(pendingLock);
+
+		vector<number> notPending;
+		for (auto &&location : locations)
+		{
+			auto found = false;
+			for (auto writeBack = pending.rbegin(); writeBack != pending.rend() && !found; writeBack++)
+			{
+				const auto inFlight = (*writeBack).find(location);
+				if (inFlight != nullptr)
+				{
+					// the pending copy is being written, so it is copied once into the cache
+					auto &bucket = cache[location];
+					bucket		 = *inFlight;
+					if (!dryRun)
+					{
+						for (auto &&entry : bucket)
+						{
+							response.push_back({entry.first, move(entry.second)});
+						}
+					}
+					found = true;
+				}
+			}
+			if (!found)
+			{
+				notPending.push_back(location);
+			}
+		}
+		locations = move(notPending);
+	}
+
+	future<vector<pair<number, bucket>>> ORAM::prefetchPath(const unordered_set<number> &path)
+	{
+		vector<number> locations;
+		for (auto &&location : path)
+		{
+			if (!inTreeTop(location) && cache.find(location) == nullptr)
+			{
+				locations.push_back(location);
+			}
+		}
+
+		vector<block> inFlight;
+		takePending(locations, inFlight, true);
+
+		// the download does not touch the cache, and the locations are not written until the next access
+		return async(launch::async, [this, locations] {
+			vector<pair<number, bucket>> downloaded;
+			if (locations.size() > 0)
+			{
+				vector<block> received;
+				{
+					auto guard = lockStorage();
+					storage->get(locations, received);
+				}
+				downloaded.reserve(locations.size());
+				for (auto i = 0uLL; i < received.size(); i++)
+				{
+					if (i % Z == 0)
+					{
+						downloaded.push_back({locations[i / Z], bucket()});
+					}
+					downloaded.back().second.push_back(move(received[i]));
+				}
+			}
+			return downloaded;
+		});
+	}
+
+	void ORAM::writeBack()
+	{
+		unique_lock<mutex> lock(pendingLock);
+		while (true)
+		{
+			// a failed write-back is retried once its error is reported, or once more on destruction
+			pendingChanged.wait(lock, [this] { return stopping || (!pending.empty() && !writeBackError); });
+			if (pending.empty())
+			{
+				return;
+			}
+
+			// the bucket set stays in pending (and visible to reads) until it is written;
+			// references to deque elements survive push_back
+			auto &written = pending.front();
+			lock.unlock();
+
+			exception_ptr error;
+			try
+			{
+				auto guard = lockStorage();
+				storage->set(written.all());
+			}
+			catch (...)
+			{
+				error = current_exception();
+			}
+
+			lock.lock();
+			if (error && !stopping)
+			{
+				// the buckets stay in pending, so they are still served to reads and nothing is lost
+				writeBackError = error;
+			}
+			else
+			{
+				if (error)
+				{
+					// destructor must not throw; the storage is gone, so are these buckets
+					TRACE(TRACE_ERROR, boost::format("write-back of %1% buckets failed on destruction") % written.size());
+				}
+				pending.pop_front();
+			}
+			pendingChanged.notify_all();
+		}
+	}
+
+	void ORAM::flushWriteBack()
+	{
+		unique_lock<mutex> lock(pendingLock);
+		pendingChanged.wait(lock, [this] { return writeBackError || pending.empty(); });
+		rethrowWriteBackError();
+	}
+
+	void ORAM::rethrowWriteBackError()
+	{
+		if (writeBackError)
+		{
+			// the writer retries the failed write-back as soon as the error is taken
+			auto error = exchange(writeBackError, nullptr);
+			pendingChanged.notify_all();
+			rethrow_exception(error);
+		}
+	}
+
+#pragma region ConcurrentORAM
+
+	ConcurrentORAM::ConcurrentORAM(const shared_ptr<ORAM> oram, const number batchSize) :
+		oram(oram),
+		batchSize(batchSize),
+		head(&stub),
+		tail(&stub)
+	{
+		if (batchSize == 0)
+		{
+			throw Exception("batch size must be greater than zero");
+		}
+		if (batchSize > oram->batchSize)
+		{
+			throw Exception(boost::format("batch size %1% exceeds the batch size of the ORAM (%2%)") % batchSize % oram->batchSize);
+		}
+
+		worker = thread(&ConcurrentORAM::run, this);
+	}
+
+	ConcurrentORAM::~ConcurrentORAM()
+	{
+		{
+			lock_guard<mutex> guard(wakeLock);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	future<bytes> ConcurrentORAM::get(const number block)
+	{
+		return submit(block, bytes());
+	}
+
+	future<bytes> ConcurrentORAM::put(const number block, const bytes &data)
+	{
+#if INPUT_CHECKS
+		if (data.size() == 0)
+		{
+			throw Exception("cannot put empty data (empty payload denotes GET)");
+		}
+#endif
+
+		return submit(block, data);
+	}
+
+	future<bytes> ConcurrentORAM::submit(const number block, const bytes &data)
+	{
+#if INPUT_CHECKS
+		// a failing request would fail the whole batch it lands in
+		if (block >= oram->blocks)
+		{
+			throw Exception(boost::format("block %1% out of bound (capacity %2%)") % block % oram->blocks);
+		}
+#endif
+
+		auto request   = new Request();
+		request->block = block;
+		request->data  = data;
+		auto response  = request->response.get_future();
+
+		push(request);
+
+		// the worker sets sleeping before it checks pending, we increment pending before we check sleeping,
+		// so either it sees the request or we see it asleep
+		pending++;
+		if (sleeping)
+		{
+			lock_guard<mutex> guard(wakeLock);
+			wake.notify_one();
+		}
+
+		return response;
+	}
+
+	void ConcurrentORAM::push(Request *request)
+	{
+		request->next.store(nullptr, memory_order_relaxed);
+		const auto previous = head.exchange(request, memory_order_acq_rel);
+		previous->next.store(request, memory_order_release);
 	}
+
+	ConcurrentORAM::Request *ConcurrentORAM::pop()
+	{
+		auto first = tail;
+		auto next  = first->next.load(memory_order_acquire);
+
+		// skip the stub
+		if (first == &stub)
+		{
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			tail  = next;
+			first = next;
+			next  = next->next.load(memory_order_acquire);
+		}
+
+		if (next != nullptr)
+		{
+			tail = next;
+			return first;
+		}
+
+		// first is the last element, unless a producer has exchanged head but not linked yet
+		if (first != head.load(memory_order_acquire))
+		{
+			return nullptr;
+		}
+
+		// re-insert the stub behind the last element, so that it can be detached
+		push(&stub);
+		next = first->next.load(memory_order_acquire);
+		if (next != nullptr)
+		{
+			tail = next;
+			return first;
+		}
+
+		return nullptr;
+	}
+
+	void ConcurrentORAM::run()
+	{
+		vector<Request *> batch;
+		vector<block> requests;
+		vector<bytes> response;
+
+		while (true)
+		{
+			while (batch.size() < batchSize)
+			{
+				auto request = pop();
+				if (request == nullptr)
+				{
+					break;
+				}
+				pending--;
+				batch.push_back(request);
+			}
+
+			if (batch.size() == 0)
+			{
+				unique_lock<mutex> lock(wakeLock);
+				sleeping = true;
+				wake.wait(lock, [this]() { return pending > 0 || stopping; });
+				sleeping = false;
+
+				if (pending == 0 && stopping)
+				{
+					return;
+				}
+				continue;
+			}
+
+			requests.clear();
+			response.clear();
+			for (auto &&request : batch)
+			{
+				requests.push_back({request->block, move(request->data)});
+			}
+
+			try
+			{
+				oram->multiple(requests, response);
+				for (auto i = 0uLL; i < batch.size(); i++)
+				{
+					batch[i]->response.set_value(move(response[i]));
+				}
+			}
+			catch (...)
+			{
+				for (auto &&request : batch)
+				{
+					request->response.set_exception(current_exception());
+				}
+			}
+
+			for (auto &&request : batch)
+			{
+				delete request;
+			}
+			batch.clear();
+		}
+	}
+
+#pragma endregion ConcurrentORAM
+
+#pragma region BucketCache
+
+	BucketCache::BucketCache(const number height) :
+		levels(height)
+	{
+	}
+
+	vector<number>::const_iterator BucketCache::position(const vector<number> &level, const number location) const
+	{
+		return lower_bound(level.begin(), level.end(), location, [this](const number index, const number location) {
+			return entries[index].first < location;
+		});
+	}
+
+	bucket *BucketCache::find(const number location)
+	{
+		return const_cast<bucket *>(static_cast<const BucketCache *>(this)->find(location));
+	}
+
+	const bucket *BucketCache::find(const number location) const
+	{
+		// location 1 is the root (level 0), a location on level l has l + 1 significant bits
+		const auto &level = levels[sizeof(number) * CHAR_BIT - 1 - __builtin_clzll(location)];
+		const auto found  = position(level, location);
+		return found != level.end() && entries[*found].first == location ? &entries[*found].second : nullptr;
+	}
+
+	bucket &BucketCache::operator[](const number location)
+	{
+		auto &level		 = levels[sizeof(number) * CHAR_BIT - 1 - __builtin_clzll(location)];
+		const auto found = position(level, location);
+		if (found != level.end() && entries[*found].first == location)
+		{
+			return entries[*found].second;
+		}
+
+		level.insert(found, entries.size());
+		entries.push_back({location, bucket()});
+		return entries.back().second;
+	}
+
+	void BucketCache::clear()
+	{
+		entries.clear();
+		for (auto &&level : levels)
+		{
+			level.clear();
+		}
+	}
+
+	const vector<pair<number, bucket>> &BucketCache::all() const
+	{
+		return entries;
+	}
+
+	number BucketCache::size() const
+	{
+		return entries.size();
+	}
+
+#pragma endregion BucketCache
 }
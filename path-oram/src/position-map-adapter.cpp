@@ -1,8 +1,14 @@
 #include "position-map-adapter.hpp"
 
+#include "utility.hpp"
+
 #include <boost/format.hpp>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace PathORAM
 {
@@ -11,6 +17,13 @@ namespace PathORAM
 
 	AbsPositionMapAdapter::~AbsPositionMapAdapter(){};
 
+	number AbsPositionMapAdapter::getAndSet(const number block, const number leaf)
+	{
+		const auto previous = get(block);
+		set(block, leaf);
+		return previous;
+	}
+
 	InMemoryPositionMapAdapter::~InMemoryPositionMapAdapter()
 	{
 		delete[] map;
@@ -76,32 +89,210 @@ namespace PathORAM
 #endif
 	}
 
+	PackedPositionMapAdapter::PackedPositionMapAdapter(const number capacity, const number logCapacity, const string filename, const bool override) :
+		capacity(capacity),
+		width(max(logCapacity, 2uLL) - 1),
+		mask(width >= 64 ? ULLONG_MAX : ((number)1 << width) - 1),
+		mapSize(((capacity * width + 63) / 64 + 1) * sizeof(number)) // one extra word, so that a read of two words never goes out of bounds
+	{
+		if (filename.empty())
+		{
+			words = (number*)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (words == MAP_FAILED)
+			{
+				throw Exception(boost::format("cannot allocate %1% bytes: %2%") % mapSize % strerror(errno));
+			}
+			return;
+		}
+
+		file = open(filename.c_str(), O_RDWR | (override ? O_CREAT | O_TRUNC : 0), 0644);
+		if (file == -1)
+		{
+			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
+		}
+
+		struct stat info;
+		if (override)
+		{
+			if (ftruncate(file, mapSize) == -1)
+			{
+				close(file);
+				throw Exception(boost::format("cannot resize %1% to %2% bytes: %3%") % filename % mapSize % strerror(errno));
+			}
+		}
+		else if (fstat(file, &info) == -1 || (number)info.st_size != mapSize)
+		{
+			close(file);
+			throw Exception(boost::format("%1% is not a packed map of %2% entries of %3% bits") % filename % capacity % width);
+		}
+
+		words = (number*)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (words == MAP_FAILED)
+		{
+			close(file);
+			throw Exception(boost::format("cannot map %1%: %2%") % filename % strerror(errno));
+		}
+
+		// blocks are remapped uniformly at random, read-ahead only wastes I/O
+		madvise(words, mapSize, MADV_RANDOM);
+	}
+
+	PackedPositionMapAdapter::~PackedPositionMapAdapter()
+	{
+		if (file != -1)
+		{
+			msync(words, mapSize, MS_SYNC);
+		}
+		munmap(words, mapSize);
+		if (file != -1)
+		{
+			close(file);
+		}
+	}
+
+	number PackedPositionMapAdapter::get(const number block) const
+	{
+		checkCapacity(block);
+
+		const auto bit	  = block * width;
+		const auto word	  = bit / 64;
+		const auto offset = bit % 64;
+
+		auto value = words[word] >> offset;
+		if (offset + width > 64)
+		{
+			value |= words[word + 1] << (64 - offset);
+		}
+
+		return value & mask;
+	}
+
+	void PackedPositionMapAdapter::set(const number block, const number leaf)
+	{
+		checkCapacity(block);
+
+#if INPUT_CHECKS
+		if (leaf > mask)
+		{
+			throw Exception(boost::format("leaf %1% does not fit in %2% bits") % leaf % width);
+		}
+#endif
+
+		const auto bit	  = block * width;
+		const auto word	  = bit / 64;
+		const auto offset = bit % 64;
+
+		words[word] = (words[word] & ~(mask << offset)) | (leaf << offset);
+		if (offset + width > 64)
+		{
+			const auto shift = 64 - offset;
+			words[word + 1]	 = (words[word + 1] & ~(mask >> shift)) | (leaf >> shift);
+		}
+	}
+
+	void PackedPositionMapAdapter::checkCapacity(const number block) const
+	{
+#if INPUT_CHECKS
+		if (block >= capacity)
+		{
+			throw Exception(boost::format("block %1% out of bound (capacity %2%)") % block % capacity);
+		}
+#endif
+	}
+
 	ORAMPositionMapAdapter::~ORAMPositionMapAdapter()
 	{
 	}
 
-	ORAMPositionMapAdapter::ORAMPositionMapAdapter(const shared_ptr<ORAM> oram) :
-		oram(oram)
+	ORAMPositionMapAdapter::ORAMPositionMapAdapter(const shared_ptr<ORAM> oram, const number packing) :
+		oram(oram),
+		packing(packing)
 	{
+		if (packing == 0)
+		{
+			throw Exception("packing must be greater than zero");
+		}
 	}
 
 	number ORAMPositionMapAdapter::get(const number block) const
 	{
 		bytes returned;
-		oram->get(block, returned);
-		uchar buffer[returned.size()];
-		copy(returned.begin(), returned.end(), buffer);
+		oram->get(block / packing, returned);
 
-		return ((number *)buffer)[0];
+		number leaf		  = 0;
+		const auto offset = (block % packing) * sizeof(number);
+		if (returned.size() >= offset + sizeof(number))
+		{
+			memcpy(&leaf, returned.data() + offset, sizeof(number));
+		}
+
+		return leaf;
 	}
 
 	void ORAMPositionMapAdapter::set(const number block, const number leaf)
 	{
-		number buffer[1];
-		buffer[0] = leaf;
+		getAndSet(block, leaf);
+	}
+
+	number ORAMPositionMapAdapter::getAndSet(const number block, const number leaf)
+	{
+		number previous	  = 0;
+		const auto offset = (block % packing) * sizeof(number);
+
+		bytes returned;
+		oram->update(
+			block / packing,
+			[&](bytes &content) {
+				// a block that was never written is empty
+				if (content.size() < offset + sizeof(number))
+				{
+					content.resize(packing * sizeof(number), 0x00);
+				}
+				memcpy(&previous, content.data() + offset, sizeof(number));
+				memcpy(content.data() + offset, &leaf, sizeof(number));
+			},
+			returned);
+
+		return previous;
+	}
+
+	shared_ptr<AbsPositionMapAdapter> ORAMPositionMapAdapter::recursive(const number capacity, const number blockSize, const number Z, const number directLimit, const number treeTopSize)
+	{
+		const auto packing = blockSize / sizeof(number);
+		const auto entries = (capacity + packing - 1) / packing; // ORAM blocks on this level
+
+		// at least as many leaves as blocks (the tree is at most half full)
+		auto logCapacity = 3uLL;
+		while (((number)1 << (logCapacity - 1)) < entries)
+		{
+			logCapacity++;
+		}
+
+		auto storage = make_shared<InMemoryStorageAdapter>((number)1 << logCapacity, blockSize, bytes(), Z);
+		auto map	 = entries <= directLimit ?
+						   shared_ptr<AbsPositionMapAdapter>(make_shared<InMemoryPositionMapAdapter>(entries)) :
+						   recursive(entries, blockSize, Z, directLimit, treeTopSize);
+
+		// only the blocks in use need random leaves, so that the next level is exactly entries / packing
+		storage->fillWithZeroes();
+		vector<number> leaves;
+		getRandomULongs((number)1 << (logCapacity - 1), entries, leaves);
+		for (auto i = 0uLL; i < entries; i++)
+		{
+			map->set(i, leaves[i]);
+		}
 
-		auto data = bytes((uchar *)buffer, (uchar *)buffer + sizeof(number));
+		auto oram = make_shared<ORAM>(
+			logCapacity,
+			blockSize,
+			Z,
+			storage,
+			map,
+			make_shared<InMemoryStashAdapter>(3 * logCapacity * Z),
+			false,
+			1,
+			treeTopSize);
 
-		oram->put(block, data);
+		return make_shared<ORAMPositionMapAdapter>(oram, packing);
 	}
 }
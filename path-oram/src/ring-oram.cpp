@@ -0,0 +1,383 @@
+#include "ring-oram.hpp"
+
+#include "utility.hpp"
+
+#include <boost/format.hpp>
+#include <boost/range/iterator_range.hpp>
+
+namespace PathORAM
+{
+	using namespace std;
+	using boost::format;
+
+	RingORAM::RingORAM(
+		const number logCapacity,
+		const number blockSize,
+		const number Z,
+		const number S,
+		const number A,
+		const shared_ptr<AbsStorageAdapter> storage,
+		const shared_ptr<AbsPositionMapAdapter> map,
+		const shared_ptr<AbsStashAdapter> stash,
+		const number batchSize) :
+		storage(storage),
+		map(map),
+		stash(stash),
+		dataSize(blockSize),
+		Z(Z),
+		S(S),
+		A(A),
+		height(logCapacity),
+		buckets((number)1 << logCapacity),
+		blocks(((number)1 << logCapacity) * Z),
+		tree(logCapacity),
+		batchSize(batchSize)
+	{
+		if (S == 0)
+		{
+			throw Exception(boost::format("S must be greater than zero (provided %1%)") % S);
+		}
+
+		if (A == 0)
+		{
+			throw Exception(boost::format("A must be greater than zero (provided %1%)") % A);
+		}
+
+		// fill all slots with random bits, marks them as dummies
+		storage->fillWithZeroes();
+
+		Metadata empty;
+		empty.ids.assign(Z + S, ULONG_MAX);
+		empty.valid.assign(Z + S, true);
+		metadata.assign(buckets, empty);
+
+		// generate random position map
+		vector<number> leaves;
+		getRandomULongs(1 << (height - 1), blocks, leaves);
+		for (number i = 0; i < blocks; ++i)
+		{
+			map->set(i, leaves[i]);
+		}
+	}
+
+	RingORAM::RingORAM(const number logCapacity, const number blockSize, const number Z, const number S, const number A) :
+		RingORAM(logCapacity,
+				 blockSize,
+				 Z,
+				 S,
+				 A,
+				 make_shared<InMemoryStorageAdapter>((1 << logCapacity) * (Z + S), blockSize, bytes(), 1),
+				 make_shared<InMemoryPositionMapAdapter>(((1 << logCapacity) * Z) + Z),
+				 make_shared<InMemoryStashAdapter>(3 * logCapacity * Z))
+	{
+	}
+
+	void RingORAM::get(const number block, bytes &response)
+	{
+		bytes data;
+		access(true, block, data, response);
+	}
+
+	void RingORAM::put(const number block, const bytes &data)
+	{
+		bytes response;
+		access(false, block, data, response);
+	}
+
+	void RingORAM::multiple(const vector<block> &requests, vector<bytes> &response)
+	{
+#if INPUT_CHECKS
+		if (requests.size() > batchSize)
+		{
+			throw Exception(boost::format("Too many requests (%1%) for batch size %2%") % requests.size() % batchSize);
+		}
+#endif
+
+		response.resize(requests.size());
+		for (auto i = 0u; i < requests.size(); i++)
+		{
+			access(requests[i].second.size() == 0, requests[i].first, requests[i].second, response[i]);
+		}
+	}
+
+	void RingORAM::load(vector<block> &data)
+	{
+		vector<pair<const number, bucket>> writeRequests;
+		writeRequests.reserve((data.size() + Z - 1) / Z * (Z + S));
+
+		vector<pair<number, Metadata>> written;
+		tree.load(data, Z, *map, [this, &writeRequests, &written](const number location, vector<block> &blocks) {
+			written.push_back({location, permuteBucket(location, blocks, writeRequests)});
+		});
+
+		storage->set(boost::make_iterator_range(writeRequests.begin(), writeRequests.end()));
+
+		for (auto &&[location, bucket] : written)
+		{
+			metadata[location] = move(bucket);
+		}
+	}
+
+	void RingORAM::access(const bool read, const number block, const bytes &data, bytes &response)
+	{
+		TRACE(TRACE_ACCESS, boost::format("ring %1% block %2%") % (read ? "get" : "put") % block);
+
+		// remap block
+		const auto previousPosition = map->getAndSet(block, getRandomULong(1 << (height - 1)));
+
+		// read one slot per bucket, the block goes to stash
+		readPath(previousPosition, block);
+
+		// update block
+		if (!read) // if "write"
+		{
+			stash->update(block, data);
+		}
+		stash->get(block, response);
+
+		// evict every A accesses
+		round = (round + 1) % A;
+		if (round == 0)
+		{
+			evictPath();
+		}
+
+		// refresh the buckets on the path that were read S times
+		earlyReshuffle(previousPosition);
+	}
+
+	void RingORAM::readPath(const number leaf, const number block)
+	{
+		vector<number> locations;
+		locations.reserve(height);
+
+		// for levels from root to leaf
+		for (number level = 0; level < height; level++)
+		{
+			auto &bucket = metadata[tree.bucketForLevelLeaf(level, leaf)];
+
+			// the slot of the block if it is in this bucket, a random valid dummy otherwise;
+			// there is always a valid dummy, since a bucket is reshuffled after S reads
+			auto slot = ULONG_MAX;
+			vector<number> dummies;
+			for (number i = 0; i < Z + S; i++)
+			{
+				if (bucket.valid[i])
+				{
+					if (bucket.ids[i] == block)
+					{
+						slot = i;
+						break;
+					}
+					if (bucket.ids[i] == ULONG_MAX)
+					{
+						dummies.push_back(i);
+					}
+				}
+			}
+			if (slot == ULONG_MAX)
+			{
+				slot = dummies[getRandomULong(dummies.size())];
+			}
+
+			bucket.valid[slot] = false;
+			bucket.count++;
+			locations.push_back(slotLocation(tree.bucketForLevelLeaf(level, leaf), slot));
+		}
+
+		vector<pair<number, bytes>> response; // {ID, payload}, the block parameter shadows the type
+		storage->get(locations, response);
+
+		for (auto &&[id, data] : response)
+		{
+			if (id == block)
+			{
+				stash->add(id, move(data));
+			}
+		}
+	}
+
+	void RingORAM::readBuckets(const number leaf, const vector<number> &levels)
+	{
+		vector<number> locations;
+		locations.reserve(levels.size() * Z);
+
+		for (auto &&level : levels)
+		{
+			const auto location = tree.bucketForLevelLeaf(level, leaf);
+			const auto &bucket	= metadata[location];
+
+			// all valid real slots, padded to Z with random valid dummies (so the reads do not reveal the occupancy)
+			vector<number> reals, dummies;
+			for (number i = 0; i < Z + S; i++)
+			{
+				if (bucket.valid[i])
+				{
+					(bucket.ids[i] == ULONG_MAX ? dummies : reals).push_back(i);
+				}
+			}
+			for (number i = 0; reals.size() < Z && i < dummies.size(); i++)
+			{
+				swap(dummies[i], dummies[i + getRandomULong(dummies.size() - i)]);
+				reals.push_back(dummies[i]);
+			}
+
+			for (auto &&slot : reals)
+			{
+				locations.push_back(slotLocation(location, slot));
+			}
+		}
+
+		vector<block> response;
+		storage->get(locations, response);
+
+		for (auto &&[id, data] : response)
+		{
+			// skip dummies
+			if (id != ULONG_MAX)
+			{
+				stash->add(id, move(data));
+			}
+		}
+	}
+
+	void RingORAM::writeBuckets(const number leaf, const vector<number> &levels)
+	{
+		vector<bool> write(height, false);
+		for (auto &&level : levels)
+		{
+			write[level] = true;
+		}
+
+		// only IDs are collected, payloads are moved out of stash for the blocks that get placed
+		vector<number> stashed;
+		stash->forEach([&stashed](const number block, const uchar *, const number) { stashed.push_back(block); });
+
+		// one position map lookup per stash block: the deepest level on this path it may go to
+		vector<vector<number>> byLevel(height); // stash block IDs grouped by their deepest level
+		for (auto &&id : stashed)
+		{
+			byLevel[tree.deepestCommonLevel(leaf, map->get(id))].push_back(id);
+		}
+
+		vector<pair<const number, bucket>> requests;	// storage SET requests (batching)
+		requests.reserve(levels.size() * (Z + S));
+		vector<pair<number, Metadata>> written; // the new metadata, it replaces the old one once the buckets are in storage
+		written.reserve(levels.size());
+
+		// following the path from leaf to root (greedy),
+		// blocks that did not fit deeper (or whose bucket is not written) stay candidates for the levels above
+		vector<number> candidates;
+		for (int level = height - 1; level >= 0; level--)
+		{
+			candidates.insert(candidates.end(), byLevel[level].begin(), byLevel[level].end());
+			if (!write[level])
+			{
+				continue;
+			}
+
+			vector<block> reals;
+			while (reals.size() < Z && candidates.size() != 0)
+			{
+				const auto id = candidates.back();
+				candidates.pop_back();
+
+				reals.push_back({id, bytes()});
+				stash->take(id, reals.back().second);
+			}
+
+			const auto location = tree.bucketForLevelLeaf(level, leaf);
+			written.push_back({location, permuteBucket(location, reals, requests)});
+		}
+
+		try
+		{
+			storage->set(boost::make_iterator_range(requests.begin(), requests.end()));
+		}
+		catch (...)
+		{
+			// the placed blocks did not reach the storage, they go back to the stash (the metadata still describes the old buckets)
+			for (auto &&[location, slot] : requests)
+			{
+				if (slot[0].first != ULONG_MAX)
+				{
+					stash->add(slot[0].first, move(slot[0].second));
+				}
+			}
+			throw;
+		}
+
+		for (auto &&[location, bucket] : written)
+		{
+			metadata[location] = move(bucket);
+		}
+	}
+
+	void RingORAM::evictPath()
+	{
+		const auto leaf = tree.reverseLexicographicLeaf(evictions++);
+
+		TRACE(TRACE_ACCESS, boost::format("ring evict path %1%") % leaf);
+
+		vector<number> levels;
+		for (number level = 0; level < height; level++)
+		{
+			levels.push_back(level);
+		}
+
+		readBuckets(leaf, levels);
+		writeBuckets(leaf, levels);
+	}
+
+	void RingORAM::earlyReshuffle(const number leaf)
+	{
+		vector<number> levels;
+		for (number level = 0; level < height; level++)
+		{
+			if (metadata[tree.bucketForLevelLeaf(level, leaf)].count >= S)
+			{
+				levels.push_back(level);
+			}
+		}
+
+		if (levels.size() > 0)
+		{
+			readBuckets(leaf, levels);
+			writeBuckets(leaf, levels);
+		}
+	}
+
+	RingORAM::Metadata RingORAM::permuteBucket(const number location, vector<block> &reals, vector<pair<const number, bucket>> &requests)
+	{
+		bucket slots;
+		slots.reserve(Z + S);
+		move(reals.begin(), reals.end(), back_inserter(slots));
+		while (slots.size() < Z + S)
+		{
+			// if nothing to insert, insert dummy (for security)
+			slots.push_back({ULONG_MAX, getRandomBlock(dataSize)});
+		}
+
+		// Fisher-Yates shuffle
+		for (uint i = 0; i < slots.size() - 1; i++)
+		{
+			uint j = i + getRandomUInt(slots.size() - i);
+			swap(slots[i], slots[j]);
+		}
+
+		Metadata bucket;
+		bucket.ids.resize(Z + S);
+		bucket.valid.assign(Z + S, true);
+		for (number i = 0; i < Z + S; i++)
+		{
+			bucket.ids[i] = slots[i].first;
+			requests.push_back({slotLocation(location, i), {move(slots[i])}});
+		}
+		return bucket;
+	}
+
+	number RingORAM::slotLocation(const number location, const number slot) const
+	{
+		return location * (Z + S) + slot;
+	}
+}
@@ -4,6 +4,8 @@
 
 #include <algorithm>
 #include <boost/format.hpp>
+#include <climits>
+#include <cmath>
 #include <cstring>
 #include <fstream>
 #include <iterator>
@@ -15,6 +17,28 @@ namespace PathORAM
 
 	AbsStashAdapter::~AbsStashAdapter() {}
 
+	void AbsStashAdapter::add(const number block, bytes &&data)
+	{
+		add(block, (const bytes &)data);
+	}
+
+	void AbsStashAdapter::take(const number block, bytes &response)
+	{
+		response.clear();
+		get(block, response);
+		deleteBlock(block);
+	}
+
+	void AbsStashAdapter::forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const
+	{
+		vector<block> all;
+		getAll(all);
+		for (auto &&[id, data] : all)
+		{
+			visitor(id, data.data(), data.size());
+		}
+	}
+
 	InMemoryStashAdapter::~InMemoryStashAdapter() {}
 
 	InMemoryStashAdapter::InMemoryStashAdapter(const number capacity) :
@@ -47,6 +71,13 @@ namespace PathORAM
 		stash.insert({block, data});
 	}
 
+	void InMemoryStashAdapter::add(const number block, bytes &&data)
+	{
+		checkOverflow(block);
+
+		stash.try_emplace(block, move(data));
+	}
+
 	void InMemoryStashAdapter::update(const number block, const bytes &data)
 	{
 		checkOverflow(block);
@@ -63,11 +94,31 @@ namespace PathORAM
 		}
 	}
 
+	void InMemoryStashAdapter::take(const number block, bytes &response)
+	{
+		// the node is detached from the map, so its payload can be moved out
+		auto node = stash.extract(block);
+		if (node.empty())
+		{
+			response.clear();
+			return;
+		}
+		response = move(node.mapped());
+	}
+
 	void InMemoryStashAdapter::deleteBlock(const number block)
 	{
 		stash.erase(block);
 	}
 
+	void InMemoryStashAdapter::forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const
+	{
+		for (auto &&[id, data] : stash)
+		{
+			visitor(id, data.data(), data.size());
+		}
+	}
+
 	void InMemoryStashAdapter::checkOverflow(const number block) const
 	{
 #if INPUT_CHECKS
@@ -154,4 +205,163 @@ namespace PathORAM
 			}
 		}
 	}
+
+	FlatStashAdapter::~FlatStashAdapter() {}
+
+	FlatStashAdapter::FlatStashAdapter(const number capacity, const number blockSize) :
+		capacity(capacity),
+		blockSize(blockSize),
+		// the table is a power of two at least twice the capacity, so there is always an empty slot to stop probing
+		shift(sizeof(number) * CHAR_BIT - max((number)1, (number)ceil(log2(2 * max(capacity, (number)1))))),
+		mask(((number)1 << (sizeof(number) * CHAR_BIT - shift)) - 1)
+	{
+		ids.assign(mask + 1, ULONG_MAX);
+		handles.resize(mask + 1);
+		arena.resize(capacity * blockSize);
+		sizes.resize(capacity);
+
+		unused.reserve(capacity);
+		for (number i = capacity; i > 0; i--)
+		{
+			unused.push_back(i - 1);
+		}
+	}
+
+	number FlatStashAdapter::home(const number block) const
+	{
+		// Fibonacci (multiplicative) hashing, the top bits are the best mixed
+		return (block * 0x9E3779B97F4A7C15uLL) >> shift;
+	}
+
+	number FlatStashAdapter::find(const number block) const
+	{
+		for (auto slot = home(block); ids[slot] != ULONG_MAX; slot = (slot + 1) & mask)
+		{
+			if (ids[slot] == block)
+			{
+				return slot;
+			}
+		}
+		return ULONG_MAX;
+	}
+
+	void FlatStashAdapter::put(const number block, const bytes &data, const bool override)
+	{
+		if (data.size() > blockSize)
+		{
+			throw Exception(boost::format("data of size %1% does not fit in stash block of size %2%") % data.size() % blockSize);
+		}
+
+		auto slot = home(block);
+		for (; ids[slot] != ULONG_MAX; slot = (slot + 1) & mask)
+		{
+			if (ids[slot] == block)
+			{
+				if (override)
+				{
+					copy(data.begin(), data.end(), arena.begin() + handles[slot] * blockSize);
+					sizes[handles[slot]] = data.size();
+				}
+				return;
+			}
+		}
+
+		if (unused.size() == 0)
+		{
+			throw Exception(boost::format("trying to insert over capacity (capacity %1%)") % capacity);
+		}
+
+		const auto handle = unused.back();
+		unused.pop_back();
+
+		ids[slot]	  = block;
+		handles[slot] = handle;
+		copy(data.begin(), data.end(), arena.begin() + handle * blockSize);
+		sizes[handle] = data.size();
+	}
+
+	void FlatStashAdapter::getAll(vector<block> &response) const
+	{
+		const auto offset = response.size();
+		forEach([&response](const number block, const uchar *data, const number size) {
+			response.push_back({block, bytes(data, data + size)});
+		});
+
+		// Fisher-Yates shuffle, randomness taken in one call
+		const auto n = response.size() - offset;
+		if (n >= 2)
+		{
+			vector<number> randomness;
+			getRandomULongs(ULONG_MAX, n - 1, randomness);
+			for (number i = 0; i < n - 1; i++)
+			{
+				const auto j = i + randomness[i] % (n - i);
+				swap(response[offset + i], response[offset + j]);
+			}
+		}
+	}
+
+	void FlatStashAdapter::add(const number block, const bytes &data)
+	{
+		put(block, data, false);
+	}
+
+	void FlatStashAdapter::update(const number block, const bytes &data)
+	{
+		put(block, data, true);
+	}
+
+	void FlatStashAdapter::get(const number block, bytes &response) const
+	{
+		const auto slot = find(block);
+		if (slot != ULONG_MAX)
+		{
+			const auto from = arena.begin() + handles[slot] * blockSize;
+			response.insert(response.begin(), from, from + sizes[handles[slot]]);
+		}
+	}
+
+	void FlatStashAdapter::deleteBlock(const number block)
+	{
+		auto hole = find(block);
+		if (hole == ULONG_MAX)
+		{
+			return;
+		}
+		unused.push_back(handles[hole]);
+
+		// backward shift: move up the entries of the cluster that would not be reachable across the hole
+		for (auto next = (hole + 1) & mask; ids[next] != ULONG_MAX; next = (next + 1) & mask)
+		{
+			// the entry may fill the hole if its home slot is not (cyclically) after the hole
+			if (((next - home(ids[next])) & mask) >= ((next - hole) & mask))
+			{
+				ids[hole]	  = ids[next];
+				handles[hole] = handles[next];
+				hole		  = next;
+			}
+		}
+		ids[hole] = ULONG_MAX;
+	}
+
+	void FlatStashAdapter::forEach(const function<void(const number block, const uchar *data, const number size)> &visitor) const
+	{
+		for (number slot = 0; slot <= mask; slot++)
+		{
+			if (ids[slot] != ULONG_MAX)
+			{
+				visitor(ids[slot], arena.data() + handles[slot] * blockSize, sizes[handles[slot]]);
+			}
+		}
+	}
+
+	bool FlatStashAdapter::exists(const number block) const
+	{
+		return find(block) != ULONG_MAX;
+	}
+
+	number FlatStashAdapter::currentSize() const
+	{
+		return capacity - unused.size();
+	}
 }
@@ -12,10 +12,20 @@
 #include <chrono>
 #include <boost/format.hpp>
 #include <cstring>
+#include <fcntl.h>
 #include <openssl/aes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <utility.hpp>
 #include <vector>
 
+#if USE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
 #define RECORD_AND_EXECUTE(condition, plain, record)                                                            \
 	if (condition)                                                                                              \
 	{                                                                                                           \
@@ -47,75 +57,70 @@ namespace PathORAM
 			checkCapacity(location);
 		}
 
-		// optimize for single operation
-		vector<bytes> raws;
-		raws.reserve(locations.size());
+		// a single buffer for the whole request (e.g. a path), no per-bucket allocation
+		bytes raws(locations.size() * blockSize);
 
-		if (locations.size() == 1)
+		if (batchLimit == 0 || locations.size() <= batchLimit)
 		{
-			raws.resize(1);
-			getAndRecord(locations[0], raws[0]);
+			getAndRecord(locations, raws.data());
 		}
 		else
 		{
-			if (batchLimit == 0 || locations.size() <= batchLimit)
+			vector<number> batch;
+			number pointer = 0;
+			while (pointer < locations.size())
 			{
-				getAndRecord(locations, raws);
-			}
-			else
-			{
-				vector<number> batch;
-				number pointer = 0;
-				while (pointer < locations.size())
-				{
-					batch.reserve(min(batchLimit, locations.size() - pointer));
-					copy(
-						locations.begin() + pointer,
-						(number)distance(locations.begin() + pointer, locations.end()) > batchLimit ?
-							  locations.begin() + pointer + batchLimit :
-							  locations.end(),
-						back_inserter(batch));
-					getAndRecord(batch, raws);
-					batch.clear();
-					pointer += batchLimit;
-				}
+				batch.reserve(min(batchLimit, locations.size() - pointer));
+				copy(
+					locations.begin() + pointer,
+					(number)distance(locations.begin() + pointer, locations.end()) > batchLimit ?
+						  locations.begin() + pointer + batchLimit :
+						  locations.end(),
+					back_inserter(batch));
+				getAndRecord(batch, raws.data() + pointer * blockSize);
+				batch.clear();
+				pointer += batchLimit;
 			}
 		}
 
-		response.reserve(locations.size() * Z);
-		for (auto &&raw : raws)
-		{
-			// decompose to ID and cipher
+		// decrypt the whole request in place, IV stays in front of every bucket
+		cipher->crypt(raws.data(), locations.size(), blockSize, DECRYPT);
 
-			bytes decrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				raw.begin(),
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.end(),
-				decrypted,
-				DECRYPT);
+		const auto length = (blockSize - AES_BLOCK_SIZE) / Z;
 
-			const auto length = decrypted.size() / Z;
+		response.reserve(response.size() + locations.size() * Z);
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			const auto decrypted = raws.data() + i * blockSize + AES_BLOCK_SIZE;
 
-			for (auto i = 0uLL; i < Z; i++)
+			for (auto j = 0uLL; j < Z; j++)
 			{
 				// decompose to ID and data (extract ID from bytes)
-				uchar buffer[AES_BLOCK_SIZE];
-				copy(decrypted.begin() + i * length, decrypted.begin() + i * length + AES_BLOCK_SIZE, buffer);
+				number id;
+				memcpy(&id, decrypted + j * length, sizeof(number));
 
 				response.push_back(
-					{((number *)buffer)[0],
-					 bytes(decrypted.begin() + i * length + AES_BLOCK_SIZE, decrypted.begin() + (i + 1) * length)});
+					{id,
+					 bytes(decrypted + j * length + AES_BLOCK_SIZE, decrypted + (j + 1) * length)});
 			}
 		}
 	}
 
 	void AbsStorageAdapter::set(const request_anyrange requests)
 	{
-		vector<block> writes;
+		setRange(requests);
+	}
+
+	void AbsStorageAdapter::set(const vector<pair<number, bucket>> &requests)
+	{
+		setRange(requests);
+	}
+
+	template <typename Range>
+	void AbsStorageAdapter::setRange(const Range &requests)
+	{
+		vector<number> locations;
+		bytes raws;
 
 		for (auto &&[location, blocks] : requests)
 		{
@@ -128,72 +133,50 @@ namespace PathORAM
 			}
 #endif
 
-			bytes toEncrypt;
-			toEncrypt.reserve(AES_BLOCK_SIZE + userBlockSize * Z);
+			// IV followed by the plaintext, written straight into the contiguous buffer
+			const auto offset = raws.size();
+			raws.resize(offset + blockSize, 0x00);
+			auto raw = raws.data() + offset;
+
+			fillRandom(raw, AES_BLOCK_SIZE);
+			raw += AES_BLOCK_SIZE;
 
 			for (auto &&block : blocks)
 			{
 				checkBlockSize(block.second.size());
 
-				// pad if necessary
-				if (block.second.size() < userBlockSize)
-				{
-					block.second.resize(userBlockSize, 0x00);
-				}
-
-				// represent ID as a vector of bytes of length AES_BLOCK_SIZE
-				const number buffer[1] = {block.first};
-				bytes id((uchar *)buffer, (uchar *)buffer + sizeof(number));
-				id.resize(AES_BLOCK_SIZE, 0x00);
-
-				// merge ID and data
-				toEncrypt.insert(toEncrypt.end(), id.begin(), id.end());
-				toEncrypt.insert(toEncrypt.end(), block.second.begin(), block.second.end());
+				// ID takes AES_BLOCK_SIZE bytes, data is padded with zeroes (buffer is zeroed)
+				memcpy(raw, &block.first, sizeof(number));
+				memcpy(raw + AES_BLOCK_SIZE, block.second.data(), block.second.size());
+				raw += AES_BLOCK_SIZE + userBlockSize;
 			}
 
-			auto iv = getRandomBlock(AES_BLOCK_SIZE);
-			bytes encrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				iv.begin(),
-				iv.end(),
-				toEncrypt.begin(),
-				toEncrypt.end(),
-				iv, // append result to IV
-				ENCRYPT);
-
-			writes.push_back({location, iv});
+			locations.push_back(location);
 		}
 
-		// optimize for single operation
-		if (writes.size() == 1)
+		// encrypt the whole request in place
+		cipher->crypt(raws.data(), locations.size(), blockSize, ENCRYPT);
+
+		if (batchLimit == 0 || locations.size() <= batchLimit)
 		{
-			setAndRecord(writes[0].first, writes[0].second);
+			setAndRecord(locations, raws.data());
 		}
 		else
 		{
-			if (batchLimit == 0 || writes.size() <= batchLimit)
+			vector<number> batch;
+			number pointer = 0;
+			while (pointer < locations.size())
 			{
-				setAndRecord(writes);
-			}
-			else
-			{
-				vector<pair<number, bytes>> batch;
-				number pointer = 0;
-				while (pointer < writes.size())
-				{
-					batch.reserve(min(batchLimit, writes.size() - pointer));
-					copy(
-						writes.begin() + pointer,
-						(number)distance(writes.begin() + pointer, writes.end()) > batchLimit ?
-							  writes.begin() + pointer + batchLimit :
-							  writes.end(),
-						back_inserter(batch));
-					setAndRecord(batch);
-					batch.clear();
-					pointer += batchLimit;
-				}
+				batch.reserve(min(batchLimit, locations.size() - pointer));
+				copy(
+					locations.begin() + pointer,
+					(number)distance(locations.begin() + pointer, locations.end()) > batchLimit ?
+						  locations.begin() + pointer + batchLimit :
+						  locations.end(),
+					back_inserter(batch));
+				setAndRecord(batch, raws.data() + pointer * blockSize);
+				batch.clear();
+				pointer += batchLimit;
 			}
 		}
 	}
@@ -228,6 +211,30 @@ namespace PathORAM
 		}
 	}
 
+	void AbsStorageAdapter::getInternal(const vector<number> &locations, uchar *response) const
+	{
+		vector<bytes> raws;
+		raws.reserve(locations.size());
+		getInternal(locations, raws);
+
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			copy(raws[i].begin(), raws[i].end(), response + i * blockSize);
+		}
+	}
+
+	void AbsStorageAdapter::setInternal(const vector<number> &locations, const uchar *raw)
+	{
+		vector<block> requests;
+		requests.reserve(locations.size());
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			requests.push_back({locations[i], bytes(raw + i * blockSize, raw + (i + 1) * blockSize)});
+		}
+
+		setInternal(requests);
+	}
+
 	void AbsStorageAdapter::checkCapacity(const number location) const
 	{
 #if INPUT_CHECKS
@@ -250,6 +257,7 @@ namespace PathORAM
 
 	AbsStorageAdapter::AbsStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const number Z, const number batchLimit) :
 		key(key.size() == KEYSIZE ? key : getRandomBlock(KEYSIZE)),
+		cipher(make_unique<CipherContext>(this->key)),
 		Z(Z),
 		batchLimit(batchLimit),
 		capacity(capacity),
@@ -342,39 +350,74 @@ namespace PathORAM
 			});
 	}
 
+	void AbsStorageAdapter::setAndRecord(const vector<number> &locations, const uchar *raw)
+	{
+		RECORD_AND_EXECUTE(
+			onStorageRequest.empty() || !supportsBatchSet(),
+			setInternal(locations, raw),
+			onStorageRequest(false, locations.size(), locations.size() * blockSize, elapsed));
+	}
+
+	void AbsStorageAdapter::getAndRecord(const vector<number> &locations, uchar *response) const
+	{
+		RECORD_AND_EXECUTE(
+			onStorageRequest.empty() || !supportsBatchGet(),
+			getInternal(locations, response),
+			onStorageRequest(true, locations.size(), locations.size() * blockSize, elapsed));
+	}
+
 #pragma endregion AbsStorageAdapter
 
 #pragma region InMemoryStorageAdapter
 
 	InMemoryStorageAdapter::~InMemoryStorageAdapter()
 	{
-		for (number i = 0; i < capacity; i++)
-		{
-			delete[] blocks[i];
-		}
-		delete[] blocks;
+		munmap(blocks, slabSize);
 	}
 
 	InMemoryStorageAdapter::InMemoryStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const number Z, const number batchLimit) :
 		AbsStorageAdapter(capacity, userBlockSize, key, Z, batchLimit),
-		blocks(new uchar *[capacity])
+		stride((blockSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE),
+		slabSize(max(capacity * stride, (number)1)),
+		blocks((uchar *)mmap(nullptr, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))
 	{
-		for (auto i = 0uLL; i < capacity; i++)
+		if (blocks == MAP_FAILED)
 		{
-			blocks[i] = new uchar[blockSize];
+			throw Exception(boost::format("cannot allocate %1% bytes for in-memory storage: %2%") % slabSize % strerror(errno));
 		}
 
+#ifdef MADV_HUGEPAGE
+		// a hint only, the slab works with regular pages as well
+		madvise(blocks, slabSize, MADV_HUGEPAGE);
+#endif
+
 		fillWithZeroes();
 	}
 
 	void InMemoryStorageAdapter::getInternal(const number location, bytes &response) const
 	{
-		response.insert(response.begin(), blocks[location], blocks[location] + blockSize);
+		response.insert(response.begin(), blocks + location * stride, blocks + location * stride + blockSize);
 	}
 
 	void InMemoryStorageAdapter::setInternal(const number location, const bytes &raw)
 	{
-		copy(raw.begin(), raw.end(), blocks[location]);
+		copy(raw.begin(), raw.end(), blocks + location * stride);
+	}
+
+	void InMemoryStorageAdapter::getInternal(const vector<number> &locations, uchar *response) const
+	{
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			memcpy(response + i * blockSize, blocks + locations[i] * stride, blockSize);
+		}
+	}
+
+	void InMemoryStorageAdapter::setInternal(const vector<number> &locations, const uchar *raw)
+	{
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			memcpy(blocks + locations[i] * stride, raw + i * blockSize, blockSize);
+		}
 	}
 
 #pragma endregion InMemoryStorageAdapter
@@ -436,6 +479,387 @@ namespace PathORAM
 
 #pragma endregion FileSystemStorageAdapter
 
+#pragma region MappedFileSystemStorageAdapter
+
+	MappedFileSystemStorageAdapter::~MappedFileSystemStorageAdapter()
+	{
+		msync(mapping, mapSize, MS_SYNC);
+		munmap(mapping, mapSize);
+		close(file);
+	}
+
+	MappedFileSystemStorageAdapter::MappedFileSystemStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string filename, const bool override, const number Z, const number batchLimit, const bool populate, const number syncEvery) :
+		AbsStorageAdapter(capacity, userBlockSize, key, Z, batchLimit),
+		mapSize(max(capacity * blockSize, (number)1)),
+		syncEvery(syncEvery)
+	{
+		file = open(filename.c_str(), O_RDWR | (override ? O_CREAT | O_TRUNC : 0), 0644);
+		if (file == -1)
+		{
+			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
+		}
+
+		struct stat info;
+		if (override)
+		{
+			if (ftruncate(file, mapSize) == -1)
+			{
+				close(file);
+				throw Exception(boost::format("cannot resize %1% to %2% bytes: %3%") % filename % mapSize % strerror(errno));
+			}
+		}
+		else if (fstat(file, &info) == -1 || (number)info.st_size < capacity * blockSize)
+		{
+			close(file);
+			throw Exception(boost::format("%1% is too small for %2% buckets of %3% bytes") % filename % capacity % blockSize);
+		}
+
+		mapping = (uchar *)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | (populate ? MAP_POPULATE : 0), file, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close(file);
+			throw Exception(boost::format("cannot map %1%: %2%") % filename % strerror(errno));
+		}
+
+		// paths are spread uniformly over the tree, read-ahead only wastes I/O
+		madvise(mapping, mapSize, MADV_RANDOM);
+
+		if (override)
+		{
+			fillWithZeroes();
+		}
+	}
+
+	void MappedFileSystemStorageAdapter::recordWrite()
+	{
+		if (syncEvery > 0 && ++pendingWrites >= syncEvery)
+		{
+			msync(mapping, mapSize, MS_ASYNC);
+			pendingWrites = 0;
+		}
+	}
+
+	void MappedFileSystemStorageAdapter::getInternal(const number location, bytes &response) const
+	{
+		response.insert(response.begin(), mapping + location * blockSize, mapping + (location + 1) * blockSize);
+	}
+
+	void MappedFileSystemStorageAdapter::setInternal(const number location, const bytes &raw)
+	{
+		copy(raw.begin(), raw.end(), mapping + location * blockSize);
+		recordWrite();
+	}
+
+	void MappedFileSystemStorageAdapter::getInternal(const vector<number> &locations, vector<bytes> &response) const
+	{
+		response.reserve(response.size() + locations.size());
+		for (auto &&location : locations)
+		{
+			response.emplace_back(mapping + location * blockSize, mapping + (location + 1) * blockSize);
+		}
+	}
+
+	void MappedFileSystemStorageAdapter::setInternal(const vector<pair<number, bytes>> &requests)
+	{
+		for (auto &&[location, raw] : requests)
+		{
+			copy(raw.begin(), raw.end(), mapping + location * blockSize);
+		}
+		recordWrite();
+	}
+
+	void MappedFileSystemStorageAdapter::getInternal(const vector<number> &locations, uchar *response) const
+	{
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			memcpy(response + i * blockSize, mapping + locations[i] * blockSize, blockSize);
+		}
+	}
+
+	void MappedFileSystemStorageAdapter::setInternal(const vector<number> &locations, const uchar *raw)
+	{
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			memcpy(mapping + locations[i] * blockSize, raw + i * blockSize, blockSize);
+		}
+		recordWrite();
+	}
+
+#pragma endregion MappedFileSystemStorageAdapter
+
+#if USE_IO_URING
+#pragma region IOUringStorageAdapter
+
+	IOUringStorageAdapter::~IOUringStorageAdapter()
+	{
+		release();
+	}
+
+	void IOUringStorageAdapter::release()
+	{
+		if (sqes != nullptr && sqes != MAP_FAILED)
+		{
+			munmap(sqes, sqesSize);
+		}
+		if (cqRing != nullptr && cqRing != MAP_FAILED && cqRing != sqRing)
+		{
+			munmap(cqRing, cqRingSize);
+		}
+		if (sqRing != nullptr && sqRing != MAP_FAILED)
+		{
+			munmap(sqRing, sqRingSize);
+		}
+		if (ring != -1)
+		{
+			close(ring);
+		}
+		free(staging);
+		if (file != -1)
+		{
+			close(file);
+		}
+
+		sqes	= nullptr;
+		cqRing	= nullptr;
+		sqRing	= nullptr;
+		ring	= -1;
+		staging = nullptr;
+		file	= -1;
+	}
+
+	IOUringStorageAdapter::IOUringStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string filename, const bool override, const number Z, const number batchLimit, const number queueDepth, const bool direct) :
+		AbsStorageAdapter(capacity, userBlockSize, key, Z, batchLimit),
+		stride(direct ? (blockSize + IO_URING_ALIGNMENT - 1) / IO_URING_ALIGNMENT * IO_URING_ALIGNMENT : blockSize),
+		queueDepth(queueDepth)
+	{
+		if (queueDepth == 0)
+		{
+			throw Exception(boost::format("queue depth must be greater than zero (provided %1%)") % queueDepth);
+		}
+
+		// the destructor does not run if the constructor throws
+		try
+		{
+			initialize(filename, override, direct);
+		}
+		catch (...)
+		{
+			release();
+			throw;
+		}
+	}
+
+	void IOUringStorageAdapter::initialize(const string &filename, const bool override, const bool direct)
+	{
+		const auto flags = O_RDWR | (override ? O_CREAT | O_TRUNC : 0);
+		file			 = open(filename.c_str(), flags | (direct ? O_DIRECT : 0), 0644);
+		if (file == -1 && direct && errno == EINVAL)
+		{
+			// e.g. tmpfs does not support O_DIRECT
+			file = open(filename.c_str(), flags, 0644);
+		}
+		if (file == -1)
+		{
+			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
+		}
+
+		struct stat info;
+		if (override)
+		{
+			if (ftruncate(file, capacity * stride) == -1)
+			{
+				throw Exception(boost::format("cannot resize %1% to %2% bytes: %3%") % filename % (capacity * stride) % strerror(errno));
+			}
+		}
+		else if (fstat(file, &info) == -1 || (number)info.st_size < capacity * stride)
+		{
+			throw Exception(boost::format("%1% is too small for %2% buckets of %3% bytes") % filename % capacity % stride);
+		}
+
+		io_uring_params params;
+		memset(&params, 0x00, sizeof(params));
+		ring = syscall(__NR_io_uring_setup, queueDepth, &params);
+		if (ring == -1)
+		{
+			throw Exception(boost::format("cannot set up io_uring: %1%") % strerror(errno));
+		}
+		this->queueDepth = min(queueDepth, (number)params.sq_entries);
+
+		// map the rings (older kernels need separate mappings for SQ and CQ)
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+		}
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+		cqRing = params.features & IORING_FEAT_SINGLE_MMAP ?
+					 sqRing :
+					 mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+		sqes   = (io_uring_sqe *)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+		if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+		{
+			throw Exception(boost::format("cannot map io_uring: %1%") % strerror(errno));
+		}
+
+		sqTail	= (unsigned *)((uchar *)sqRing + params.sq_off.tail);
+		sqMask	= (unsigned *)((uchar *)sqRing + params.sq_off.ring_mask);
+		sqArray = (unsigned *)((uchar *)sqRing + params.sq_off.array);
+		cqHead	= (unsigned *)((uchar *)cqRing + params.cq_off.head);
+		cqTail	= (unsigned *)((uchar *)cqRing + params.cq_off.tail);
+		cqMask	= (unsigned *)((uchar *)cqRing + params.cq_off.ring_mask);
+		cqes	= (io_uring_cqe *)((uchar *)cqRing + params.cq_off.cqes);
+
+		// one registered buffer, each in-flight request uses its own stride-sized slot
+		if (posix_memalign((void **)&staging, IO_URING_ALIGNMENT, this->queueDepth * stride) != 0)
+		{
+			throw Exception(boost::format("cannot allocate %1% bytes for io_uring buffers") % (this->queueDepth * stride));
+		}
+		iovec buffer = {staging, this->queueDepth * stride};
+		if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, &buffer, 1) == -1)
+		{
+			throw Exception(boost::format("cannot register io_uring buffers: %1%") % strerror(errno));
+		}
+
+		if (override)
+		{
+			fillWithZeroes();
+		}
+	}
+
+	void IOUringStorageAdapter::submit(const bool read, const number *first, const number count) const
+	{
+		// only this thread produces, so the tail can be read plainly
+		auto tail = *sqTail;
+		for (auto i = 0uLL; i < count; i++)
+		{
+			const auto index = tail & *sqMask;
+			auto sqe		 = &sqes[index];
+			memset(sqe, 0x00, sizeof(io_uring_sqe));
+
+			sqe->opcode	   = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+			sqe->fd		   = file;
+			sqe->addr	   = (number)(staging + i * stride);
+			sqe->len	   = stride;
+			sqe->off	   = first[i] * stride;
+			sqe->buf_index = 0;
+			sqe->user_data = i;
+
+			sqArray[index] = index;
+			tail++;
+		}
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+		// every completion of the batch is consumed before an error is reported,
+		// otherwise the next batch would read the leftovers of this one
+		auto toSubmit  = count;
+		auto completed = 0uLL;
+		string error;
+		while (completed < count)
+		{
+			if (syscall(__NR_io_uring_enter, ring, toSubmit, count - completed, IORING_ENTER_GETEVENTS, nullptr, 0) == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				throw Exception(boost::format("io_uring_enter failed: %1%") % strerror(errno));
+			}
+			toSubmit = 0;
+
+			auto head			 = *cqHead;
+			const auto available = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			for (; head != available; head++)
+			{
+				const auto &cqe = cqes[head & *cqMask];
+				if (cqe.res != (int)stride && error.empty())
+				{
+					error = boost::str(boost::format("io_uring %1% of location %2% failed: %3%") % (read ? "read" : "write") % first[cqe.user_data] % (cqe.res < 0 ? strerror(-cqe.res) : "short transfer"));
+				}
+				completed++;
+			}
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		}
+
+		if (!error.empty())
+		{
+			throw Exception(error);
+		}
+	}
+
+	void IOUringStorageAdapter::getInternal(const vector<number> &locations, uchar *response) const
+	{
+		for (auto pointer = 0uLL; pointer < locations.size(); pointer += queueDepth)
+		{
+			const auto count = min(queueDepth, locations.size() - pointer);
+			submit(true, locations.data() + pointer, count);
+
+			for (auto i = 0uLL; i < count; i++)
+			{
+				memcpy(response + (pointer + i) * blockSize, staging + i * stride, blockSize);
+			}
+		}
+	}
+
+	void IOUringStorageAdapter::setInternal(const vector<number> &locations, const uchar *raw)
+	{
+		for (auto pointer = 0uLL; pointer < locations.size(); pointer += queueDepth)
+		{
+			const auto count = min(queueDepth, locations.size() - pointer);
+			for (auto i = 0uLL; i < count; i++)
+			{
+				memcpy(staging + i * stride, raw + (pointer + i) * blockSize, blockSize);
+			}
+
+			submit(false, locations.data() + pointer, count);
+		}
+	}
+
+	void IOUringStorageAdapter::getInternal(const number location, bytes &response) const
+	{
+		uchar placeholder[blockSize];
+		getInternal(vector<number>{location}, placeholder);
+
+		response.insert(response.begin(), placeholder, placeholder + blockSize);
+	}
+
+	void IOUringStorageAdapter::setInternal(const number location, const bytes &raw)
+	{
+		setInternal(vector<number>{location}, raw.data());
+	}
+
+	void IOUringStorageAdapter::getInternal(const vector<number> &locations, vector<bytes> &response) const
+	{
+		bytes raws(locations.size() * blockSize);
+		getInternal(locations, raws.data());
+
+		response.reserve(response.size() + locations.size());
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			response.emplace_back(raws.begin() + i * blockSize, raws.begin() + (i + 1) * blockSize);
+		}
+	}
+
+	void IOUringStorageAdapter::setInternal(const vector<pair<number, bytes>> &requests)
+	{
+		vector<number> locations;
+		bytes raws;
+		locations.reserve(requests.size());
+		raws.reserve(requests.size() * blockSize);
+		for (auto &&[location, raw] : requests)
+		{
+			locations.push_back(location);
+			raws.insert(raws.end(), raw.begin(), raw.end());
+		}
+
+		setInternal(locations, raws.data());
+	}
+
+#pragma endregion IOUringStorageAdapter
+#endif
+
 #if USE_REDIS
 #pragma region RedisStorageAdapter
 
@@ -490,6 +914,166 @@ namespace PathORAM
 	}
 
 #pragma endregion RedisStorageAdapter
+
+#pragma region PipelinedRedisStorageAdapter
+
+	PipelinedRedisStorageAdapter::~PipelinedRedisStorageAdapter()
+	{
+		try
+		{
+			flush();
+		}
+		catch (...)
+		{
+			// destructors must not throw
+		}
+	}
+
+	PipelinedRedisStorageAdapter::PipelinedRedisStorageAdapter(const number capacity, const number userBlockSize, const bytes key, const string host, const bool override, const number Z, const number batchLimit, const number poolSize) :
+		AbsStorageAdapter(capacity, userBlockSize, key, Z, batchLimit),
+		redis(make_unique<sw::redis::Redis>(
+			sw::redis::ConnectionOptions(host),
+			[poolSize]() {
+				sw::redis::ConnectionPoolOptions options;
+				options.size = max(poolSize, (number)1);
+				return options;
+			}()))
+	{
+		redis->ping();
+
+		if (override)
+		{
+			redis->flushdb();
+
+			fillWithZeroes();
+			flush();
+		}
+	}
+
+	string PipelinedRedisStorageAdapter::keyFor(const number location)
+	{
+		return string((const char *)&location, sizeof(number));
+	}
+
+	void PipelinedRedisStorageAdapter::flush()
+	{
+		lock_guard<mutex> guard(pendingLock);
+		if (pending.size() > 0)
+		{
+			auto pipeline = redis->pipeline(false);
+			for (auto &&writes : pending)
+			{
+				pipeline.mset(writes.begin(), writes.end());
+			}
+			pipeline.exec();
+			pending.clear();
+		}
+	}
+
+	void PipelinedRedisStorageAdapter::getInternal(const vector<number> &locations, uchar *response) const
+	{
+		vector<string> keys;
+		keys.reserve(locations.size());
+		transform(locations.begin(), locations.end(), back_inserter(keys), keyFor);
+
+		// the deferred writes go ahead of the reads, and the lock is kept until they are applied;
+		// a read without writes to carry does not need to be ordered against other reads
+		unique_lock<mutex> guard(pendingLock);
+		auto batches = move(pending);
+		pending.clear();
+		if (batches.empty())
+		{
+			guard.unlock();
+		}
+
+		// one round trip: the previous write-backs (if any), then the reads (Redis keeps the order)
+		auto pipeline = redis->pipeline(false);
+		for (auto &&writes : batches)
+		{
+			pipeline.mset(writes.begin(), writes.end());
+		}
+		pipeline.mget(keys.begin(), keys.end());
+		optional<sw::redis::QueuedReplies> replies;
+		try
+		{
+			replies = pipeline.exec();
+		}
+		catch (...)
+		{
+			// the writes are not lost, they go with the next round trip
+			if (!batches.empty())
+			{
+				pending.insert(pending.begin(), make_move_iterator(batches.begin()), make_move_iterator(batches.end()));
+			}
+			throw;
+		}
+
+		vector<sw::redis::OptionalString> returned;
+		returned.reserve(locations.size());
+		replies->get(batches.size(), back_inserter(returned));
+
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			if (!returned[i])
+			{
+				throw Exception(boost::format("location %1% is not present in Redis") % locations[i]);
+			}
+			copy(returned[i].value().begin(), returned[i].value().end(), response + i * blockSize);
+		}
+	}
+
+	void PipelinedRedisStorageAdapter::setInternal(const vector<number> &locations, const uchar *raw)
+	{
+		redis_writes writes;
+		writes.reserve(locations.size());
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			writes.push_back({keyFor(locations[i]), string((const char *)raw + i * blockSize, blockSize)});
+		}
+
+		lock_guard<mutex> guard(pendingLock);
+		pending.push_back(move(writes));
+	}
+
+	void PipelinedRedisStorageAdapter::getInternal(const number location, bytes &response) const
+	{
+		uchar placeholder[blockSize];
+		getInternal(vector<number>{location}, placeholder);
+
+		response.insert(response.begin(), placeholder, placeholder + blockSize);
+	}
+
+	void PipelinedRedisStorageAdapter::setInternal(const number location, const bytes &raw)
+	{
+		setInternal(vector<number>{location}, raw.data());
+	}
+
+	void PipelinedRedisStorageAdapter::getInternal(const vector<number> &locations, vector<bytes> &response) const
+	{
+		bytes raws(locations.size() * blockSize);
+		getInternal(locations, raws.data());
+
+		response.reserve(response.size() + locations.size());
+		for (auto i = 0uLL; i < locations.size(); i++)
+		{
+			response.emplace_back(raws.begin() + i * blockSize, raws.begin() + (i + 1) * blockSize);
+		}
+	}
+
+	void PipelinedRedisStorageAdapter::setInternal(const vector<pair<number, bytes>> &requests)
+	{
+		redis_writes writes;
+		writes.reserve(requests.size());
+		for (auto &&[location, raw] : requests)
+		{
+			writes.push_back({keyFor(location), string(raw.begin(), raw.end())});
+		}
+
+		lock_guard<mutex> guard(pendingLock);
+		pending.push_back(move(writes));
+	}
+
+#pragma endregion PipelinedRedisStorageAdapter
 #endif
 
 // #if USE_AEROSPIKE
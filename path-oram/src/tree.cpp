@@ -0,0 +1,102 @@
+#include "tree.hpp"
+
+#include "position-map-adapter.hpp"
+#include "utility.hpp"
+
+#include <climits>
+#include <cmath>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	Tree::Tree(const number height) :
+		height(height)
+	{
+	}
+
+	number Tree::reverseLexicographicLeaf(const number i) const
+	{
+		number leaf = 0;
+		for (number bit = 0; bit + 1 < height; bit++)
+		{
+			if ((i >> bit) & 1)
+			{
+				leaf |= (number)1 << (height - 2 - bit);
+			}
+		}
+		return leaf;
+	}
+
+	bool Tree::canInclude(const number pathLeaf, const number blockPosition, const number level) const
+	{
+		// on this level, do these paths share the same bucket
+		return bucketForLevelLeaf(level, pathLeaf) == bucketForLevelLeaf(level, blockPosition);
+	}
+
+	number Tree::deepestCommonLevel(const number pathLeaf, const number blockPosition) const
+	{
+		const auto difference = pathLeaf ^ blockPosition;
+		// number of low levels where the paths have already diverged
+		const number diverged = difference == 0 ? 0 : sizeof(number) * CHAR_BIT - __builtin_clzll(difference);
+		return height - 1 - diverged;
+	}
+
+	number Tree::bucketForLevelLeaf(const number level, const number leaf) const
+	{
+		return (leaf + (1 << (height - 1))) >> (height - 1 - level);
+	}
+
+	pair<number, number> Tree::leavesForLocation(const number location) const
+	{
+		const auto level	= (number)floor(log2(location));
+		const auto toLeaves = height - level - 1;
+		return {location * (1 << toLeaves) - (1 << (height - 1)), (location + 1) * (1 << toLeaves) - 1 - (1 << (height - 1))};
+	}
+
+	void Tree::load(vector<block> &data, const number Z, AbsPositionMapAdapter &map, const function<void(const number location, vector<block> &blocks)> &place) const
+	{
+		const number maxLocation = 1 << height;
+		const auto bucketCount	 = (data.size() + Z - 1) / Z; // for rounding errors
+		const auto step			 = maxLocation / (long double)bucketCount;
+
+		if (bucketCount > maxLocation)
+		{
+			throw Exception("bulk load: too much data for ORAM");
+		}
+
+		// shuffle (such bulk load may leak in part the original order)
+		const uint n = data.size();
+		if (n >= 2)
+		{
+			// Fisher-Yates shuffle
+			for (uint i = 0; i < n - 1; i++)
+			{
+				uint j = i + getRandomUInt(n - i);
+				swap(data[i], data[j]);
+			}
+		}
+
+		auto iteration = 0uLL;
+		vector<block> blocks;
+		for (auto &&record : data)
+		{
+			// to disperse locations evenly from 1 to maxLocation
+			const auto location	  = (number)floor(1 + iteration * step);
+			const auto [from, to] = leavesForLocation(location);
+			map.set(record.first, getRandomULong(to - from + 1) + from);
+
+			blocks.push_back(record);
+			if (blocks.size() == Z)
+			{
+				place(location, blocks);
+				iteration++;
+				blocks.clear();
+			}
+		}
+		if (blocks.size() > 0)
+		{
+			place((number)floor(1 + iteration * step), blocks);
+		}
+	}
+}
@@ -1,13 +1,15 @@
 #include "utility.hpp"
 
+#include <array>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/format.hpp>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
 #include <openssl/aes.h>
 #include <openssl/evp.h>
-#include <openssl/modes.h>
 #include <openssl/rand.h>
+#include <pthread.h>
 #include <random>
 #include <sstream>
 #include <vector>
@@ -22,18 +24,61 @@ namespace PathORAM
 {
 	using namespace std;
 
-	bytes getRandomBlock(const number blockSize)
+#if !defined(TESTING) && !defined(DEBUG)
+	namespace
+	{
+		// per-thread pool of OpenSSL PRG output, so that small requests (IVs, remaps) are not a library call each
+		struct RandomBuffer
+		{
+			uchar material[RANDOM_BUFFER_SIZE];
+			number position = RANDOM_BUFFER_SIZE;
+		};
+
+		thread_local RandomBuffer randomBuffer;
+
+		void takeRandom(uchar *output, const number size)
+		{
+			// the child of fork must not replay the buffer of the parent
+			static const auto forkHandler = pthread_atfork(nullptr, nullptr, []() { randomBuffer.position = RANDOM_BUFFER_SIZE; });
+			(void)forkHandler;
+
+			if (size >= RANDOM_BUFFER_SIZE)
+			{
+				HANDLE_ERROR(RAND_bytes(output, size) == 1);
+				return;
+			}
+
+			if (randomBuffer.position + size > RANDOM_BUFFER_SIZE)
+			{
+				HANDLE_ERROR(RAND_bytes(randomBuffer.material, RANDOM_BUFFER_SIZE) == 1);
+				randomBuffer.position = 0;
+			}
+
+			// wipe what was handed out, so that the buffer never holds past IVs or positions
+			memcpy(output, randomBuffer.material + randomBuffer.position, size);
+			memset(randomBuffer.material + randomBuffer.position, 0x00, size);
+			randomBuffer.position += size;
+		}
+	}
+#endif
+
+	void fillRandom(uchar *output, const number size)
 	{
-		uchar material[blockSize];
 #if defined(TESTING) || defined(DEBUG)
-		for (number i = 0; i < blockSize; i++)
+		for (number i = 0; i < size; i++)
 		{
-			material[i] = (uchar)rand();
+			output[i] = (uchar)rand();
 		}
 #else
-		RAND_bytes(material, blockSize);
+		takeRandom(output, size);
 #endif
-		return bytes(material, material + blockSize);
+	}
+
+	bytes getRandomBlock(const number blockSize)
+	{
+		bytes material(blockSize);
+		fillRandom(material.data(), blockSize);
+		return material;
 	}
 
 	number getRandomULong(const number max)
@@ -44,18 +89,37 @@ namespace PathORAM
 		intMaterial[0]	 = rand();
 		intMaterial[1]	 = rand();
 #else
-		RAND_bytes((uchar *)material, sizeof(number));
+		takeRandom((uchar *)material, sizeof(number));
 #endif
 		return material[0] % max;
 	}
 
+	void getRandomULongs(const number max, const number count, vector<number> &output)
+	{
+		output.reserve(output.size() + count);
+#if defined(TESTING) || defined(DEBUG)
+		for (number i = 0; i < count; i++)
+		{
+			output.push_back(getRandomULong(max));
+		}
+#else
+		const auto offset = output.size();
+		output.resize(offset + count);
+		takeRandom((uchar *)(output.data() + offset), count * sizeof(number));
+		for (auto i = offset; i < output.size(); i++)
+		{
+			output[i] %= max;
+		}
+#endif
+	}
+
 	uint getRandomUInt(const uint max)
 	{
 #if defined(TESTING) || defined(DEBUG)
 		return rand() % max;
 #else
 		uint material[1];
-		RAND_bytes((uchar *)material, sizeof(uint));
+		takeRandom((uchar *)material, sizeof(uint));
 		return material[0] % max;
 #endif
 	}
@@ -68,7 +132,7 @@ namespace PathORAM
 		intMaterial[0]	 = rand();
 		intMaterial[1]	 = rand();
 #else
-		RAND_bytes((uchar *)material, sizeof(number));
+		takeRandom((uchar *)material, sizeof(number));
 #endif
 		mt19937_64 gen(material[0]);
 		uniform_real_distribution<> distribution(0, max);
@@ -111,65 +175,105 @@ namespace PathORAM
 			return;
 		}
 
-		AES_KEY aesKey;
-		uchar keyMaterial[KEYSIZE];
-		copy(keyFirst, keyLast, keyMaterial);
-		// CTR always does encryption only
-		if (mode == ENCRYPT || __blockCipherMode == CTR)
-		{
-			AES_set_encrypt_key(keyMaterial, KEYSIZE * 8, &aesKey);
-		}
-		else
-		{
-			AES_set_decrypt_key(keyMaterial, KEYSIZE * 8, &aesKey);
-		}
-
 		uchar ivMaterial[AES_BLOCK_SIZE];
 		copy(ivFist, ivLast, ivMaterial);
 
-		uchar inputMaterial[size];
-		copy(inputFirst, inputLast, inputMaterial);
+		CipherContext context(bytes(keyFirst, keyLast));
 
-		uchar outputMaterial[size];
-		memset(outputMaterial, 0x00, size);
+		output.insert(output.end(), inputFirst, inputLast);
+		context.crypt(ivMaterial, output.data() + output.size() - size, size, mode);
+	}
 
-		uint ctr_num = 0;
-		uchar ctr_buffer[AES_BLOCK_SIZE];
-		memset(ctr_buffer, 0x00, AES_BLOCK_SIZE);
+#pragma region CipherContext
 
-		// this last parameter is essentially a block cipher itself (as a function);
-		// CRYPTO_ family functions are cipher-agnostic
+	CipherContext::CipherContext(const bytes &key) :
+		key(key)
+	{
+#if INPUT_CHECKS
+		if (key.size() != KEYSIZE)
+		{
+			throw Exception(boost::format("key of size %1% bytes provided, need %2% bytes") % key.size() % KEYSIZE);
+		}
+#endif
+	}
+
+	CipherContext::~CipherContext()
+	{
+		for (auto &&row : contexts)
+		{
+			for (auto &&context : row)
+			{
+				EVP_CIPHER_CTX_free(context);
+			}
+		}
+	}
+
+	EVP_CIPHER_CTX *CipherContext::context(const EncryptionMode mode)
+	{
+		const EVP_CIPHER *cipher;
 		switch (__blockCipherMode)
 		{
 			case CBC:
-				(mode == ENCRYPT ? CRYPTO_cbc128_encrypt : CRYPTO_cbc128_decrypt)(
-					(const uchar *)inputMaterial,
-					outputMaterial,
-					size,
-					&aesKey,
-					ivMaterial,
-					(block128_f)(mode == ENCRYPT ? AES_encrypt : AES_decrypt));
+				cipher = KEYSIZE == 16 ? EVP_aes_128_cbc() : KEYSIZE == 24 ? EVP_aes_192_cbc() : EVP_aes_256_cbc();
 				break;
-
 			case CTR:
-				CRYPTO_ctr128_encrypt(
-					(const uchar *)inputMaterial,
-					outputMaterial,
-					size,
-					&aesKey,
-					ivMaterial,
-					ctr_buffer,
-					&ctr_num,
-					(block128_f)AES_encrypt);
+				cipher = KEYSIZE == 16 ? EVP_aes_128_ctr() : KEYSIZE == 24 ? EVP_aes_192_ctr() : EVP_aes_256_ctr();
 				break;
-
 			default:
 				throw Exception(boost::format("Block cipher mode not implemented: %1%") % __blockCipherMode);
 		}
 
-		output.insert(output.end(), outputMaterial, outputMaterial + size);
+		// CTR always does encryption only
+		const auto direction = __blockCipherMode == CTR ? ENCRYPT : mode;
+		auto &context		 = contexts[__blockCipherMode][mode];
+		if (context == nullptr)
+		{
+			HANDLE_ERROR((context = EVP_CIPHER_CTX_new()) != nullptr);
+			HANDLE_ERROR(EVP_CipherInit_ex(context, cipher, nullptr, key.data(), nullptr, direction == ENCRYPT ? 1 : 0));
+			HANDLE_ERROR(EVP_CIPHER_CTX_set_padding(context, 0));
+		}
+
+		return context;
+	}
+
+	void CipherContext::crypt(const uchar *iv, uchar *data, const number size, const EncryptionMode mode)
+	{
+#if INPUT_CHECKS
+		if (size == 0 || size % AES_BLOCK_SIZE != 0)
+		{
+			throw Exception(boost::format("input must be a multiple of %1% (provided %2% bytes)") % AES_BLOCK_SIZE % size);
+		}
+#endif
+
+		if (__blockCipherMode == NONE)
+		{
+			return;
+		}
+
+		auto context = this->context(mode);
+
+		// keep the key schedule, only reset the IV (and the CTR counter)
+		int length;
+		HANDLE_ERROR(EVP_CipherInit_ex(context, nullptr, nullptr, nullptr, iv, -1));
+		HANDLE_ERROR(EVP_CipherUpdate(context, data, &length, data, (int)size));
+	}
+
+	void CipherContext::crypt(uchar *buffer, const number count, const number stride, const EncryptionMode mode)
+	{
+		if (__blockCipherMode == NONE)
+		{
+			return;
+		}
+
+		for (auto i = 0uLL; i < count; i++)
+		{
+			auto record = buffer + i * stride;
+			crypt(record, record + AES_BLOCK_SIZE, stride - AES_BLOCK_SIZE, mode);
+		}
 	}
 
+#pragma endregion CipherContext
+
 	bytes fromText(const string text, const number BLOCK_SIZE)
 	{
 		stringstream padded;
@@ -255,4 +359,37 @@ namespace PathORAM
 
 		return material[0] % max;
 	}
+
+	namespace
+	{
+		mutex traceLock;
+		array<string, TRACE_BUFFER_SIZE> traceBuffer;
+		number traceNext = 0; // total messages recorded, traceNext % TRACE_BUFFER_SIZE is the slot to write next
+	}
+
+	void traceMessage(const int level, const string &message)
+	{
+		static const char *names[] = {"NONE", "ERROR", "WARNING", "INFO", "ACCESS"};
+
+		const auto entry = boost::str(boost::format("[%1%] %2%") % names[level] % message);
+
+		lock_guard<mutex> guard(traceLock);
+		traceBuffer[traceNext % TRACE_BUFFER_SIZE] = entry;
+		traceNext++;
+	}
+
+	void traceMessage(const int level, const boost::format &message)
+	{
+		traceMessage(level, boost::str(message));
+	}
+
+	void getTrace(vector<string> &output)
+	{
+		lock_guard<mutex> guard(traceLock);
+		const auto first = traceNext > TRACE_BUFFER_SIZE ? traceNext - TRACE_BUFFER_SIZE : 0;
+		for (auto i = first; i < traceNext; i++)
+		{
+			output.push_back(traceBuffer[i % TRACE_BUFFER_SIZE]);
+		}
+	}
 }
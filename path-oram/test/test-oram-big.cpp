@@ -15,6 +15,7 @@ namespace PathORAM
 	{
 #if USE_REDIS
 		StorageAdapterTypeRedis,
+		StorageAdapterTypePipelinedRedis,
 #endif
 // #if USE_AEROSPIKE
 // 		StorageAdapterTypeAerospike,
@@ -75,6 +76,9 @@ namespace PathORAM
 				case StorageAdapterTypeRedis:
 					this->storage = shared_ptr<AbsStorageAdapter>(new RedisStorageAdapter(CAPACITY + Z, BLOCK_SIZE, KEY, REDIS_HOST, true, Z));
 					break;
+				case StorageAdapterTypePipelinedRedis:
+					this->storage = shared_ptr<AbsStorageAdapter>(new PipelinedRedisStorageAdapter(CAPACITY + Z, BLOCK_SIZE, KEY, REDIS_HOST, true, Z, 300000, 2));
+					break;
 #endif
 // #if USE_AEROSPIKE
 // 				case StorageAdapterTypeAerospike:
@@ -101,7 +105,16 @@ namespace PathORAM
 									make_unique<InMemoryStashAdapter>(3 * logCapacity * z))));
 			this->stash = make_shared<InMemoryStashAdapter>(2 * LOG_CAPACITY * Z);
 
-			this->oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, true, BATCH_SIZE);
+			auto writeBackLimit = 0uLL;
+#if USE_REDIS
+			// deferred writes of the background write-back thread must reach the server ahead of the reads of the caller
+			if (storageType == StorageAdapterTypePipelinedRedis)
+			{
+				writeBackLimit = 2;
+			}
+#endif
+
+			this->oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, true, BATCH_SIZE, 0, 0, writeBackLimit);
 		}
 
 		~ORAMBigTest()
@@ -115,7 +128,7 @@ namespace PathORAM
 // #endif
 			storage.reset();
 #if USE_REDIS
-			if (get<3>(GetParam()) == StorageAdapterTypeRedis)
+			if (get<3>(GetParam()) == StorageAdapterTypeRedis || get<3>(GetParam()) == StorageAdapterTypePipelinedRedis)
 			{
 				make_unique<sw::redis::Redis>(REDIS_HOST)->flushall();
 			}
@@ -188,6 +201,8 @@ namespace PathORAM
 				auto connection = "tcp://" + host + ":6379";
 				make_unique<sw::redis::Redis>(connection)->ping();
 				result.push_back({5, 3, 32, StorageAdapterTypeRedis, true, false, 1});
+				result.push_back({5, 3, 32, StorageAdapterTypePipelinedRedis, true, false, 1});
+				result.push_back({5, 3, 32, StorageAdapterTypePipelinedRedis, false, true, 10});
 				PathORAM::ORAMBigTest::REDIS_HOST = connection;
 				break;
 			}
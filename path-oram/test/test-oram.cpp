@@ -19,9 +19,15 @@ namespace PathORAM
 
 			// by default, all calls are delegated to the real object
 			ON_CALL(*this, getInternal).WillByDefault([this](const vector<number> &locations, vector<bytes> &response) {
+				reads.insert(reads.end(), locations.begin(), locations.end());
 				return ((AbsStorageAdapter *)_real.get())->getInternal(locations, response);
 			});
 			ON_CALL(*this, setInternal).WillByDefault([this](const vector<block> &requests) {
+				this_thread::sleep_for(delay);
+				if (failing)
+				{
+					throw Exception("storage is unavailable");
+				}
 				return ((AbsStorageAdapter *)_real.get())->setInternal(requests);
 			});
 		}
@@ -51,10 +57,53 @@ namespace PathORAM
 		MOCK_METHOD(void, getInternal, (const vector<number> &locations, vector<bytes> &response), (const, override));
 		MOCK_METHOD(void, setInternal, ((const vector<block>)&requests), (override));
 
+		// simulated latency of (batch) writes
+		chrono::milliseconds delay = chrono::milliseconds(0);
+
+		// simulated outage, (batch) writes throw while set
+		atomic<bool> failing = false;
+
+		// locations of (batch) reads, in order
+		vector<number> reads;
+
 		private:
 		unique_ptr<InMemoryStorageAdapter> _real;
 	};
 
+	// delegates to the in-memory position map, lookups (but not remaps) throw while failing is set
+	class FailingPositionMap : public AbsPositionMapAdapter
+	{
+		public:
+		FailingPositionMap(number capacity) :
+			_real(capacity)
+		{
+		}
+
+		number get(const number block) const override
+		{
+			if (failing)
+			{
+				throw Exception("position map is unavailable");
+			}
+			return _real.get(block);
+		}
+
+		void set(const number block, const number leaf) override
+		{
+			_real.set(block, leaf);
+		}
+
+		number getAndSet(const number block, const number leaf) override
+		{
+			return _real.getAndSet(block, leaf);
+		}
+
+		bool failing = false;
+
+		private:
+		InMemoryPositionMapAdapter _real;
+	};
+
 	class ORAMTest : public ::testing::Test
 	{
 		public:
@@ -113,41 +162,6 @@ namespace PathORAM
 		ASSERT_NO_THROW(auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z));
 	}
 
-	TEST_F(ORAMTest, BucketFromLevelLeaf)
-	{
-		vector<pair<number, vector<number>>> tests =
-			{
-				{6, {1, 2, 5, 11, 22}},
-				{8, {1, 3, 6, 12, 24}},
-				{14, {1, 3, 7, 15, 30}},
-			};
-
-		for (auto &&test : tests)
-		{
-			for (number level = 0; level < LOG_CAPACITY; level++)
-			{
-				EXPECT_EQ(test.second[level], oram->bucketForLevelLeaf(level, test.first));
-			}
-		}
-	}
-
-	TEST_F(ORAMTest, CanInclude)
-	{
-		vector<tuple<number, number, number, bool>> tests =
-			{
-				{8, 11, 2, true},
-				{8, 11, 3, false},
-				{0, 11, 0, true},
-				{0, 11, 1, false},
-				{0, 11, 2, false},
-			};
-
-		for (auto &&test : tests)
-		{
-			EXPECT_EQ(get<3>(test), oram->canInclude(get<0>(test), get<1>(test), get<2>(test)));
-		}
-	}
-
 	TEST_F(ORAMTest, ReadPath)
 	{
 		populateStorage();
@@ -260,6 +274,56 @@ namespace PathORAM
 		});
 	}
 
+	TEST_F(ORAMTest, MultipleInvalidBlock)
+	{
+		const auto ELEMENTS = CAPACITY * Z / 2;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// a batch with an invalid request fails as a whole and does not remap (and lose) the valid blocks
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			vector<block> batch = {{id, bytes()}, {id % 2 == 0 ? CAPACITY * Z * 100 : CAPACITY * Z, bytes()}};
+			vector<bytes> response;
+			ASSERT_ANY_THROW(oram->multiple(batch, response));
+		}
+
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, PipelineInvalidBlock)
+	{
+		const auto ELEMENTS = CAPACITY * Z / 2;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// a sequence with an invalid request fails before the first access
+		vector<block> requests;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			requests.push_back({id, fromText("updated", BLOCK_SIZE)});
+		}
+		requests.push_back({CAPACITY * Z, bytes()});
+		vector<bytes> response;
+		ASSERT_ANY_THROW(oram->pipeline(requests, response));
+
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
 	TEST_F(ORAMTest, MultipleCheckCache)
 	{
 		using ::testing::An;
@@ -323,6 +387,48 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, MultipleDuplicates)
+	{
+		const auto text = [](const string &value) { return fromText(value, BLOCK_SIZE); };
+
+		oram->put(0, text("zero"));
+		oram->put(1, text("one"));
+
+		// requests are served in order, last write wins
+		vector<block> batch = {
+			{0, bytes()},
+			{0, text("zero-1")},
+			{1, bytes()},
+			{0, bytes()},
+			{0, text("zero-2")},
+			{2, text("two")},
+			{2, bytes()},
+			{1, bytes()}};
+		vector<string> expected = {"zero", "zero-1", "one", "zero-1", "zero-2", "two", "two", "one"};
+
+		auto reads = 0uLL, writes = 0uLL;
+		storage->subscribe([&](const bool read, const number count, const number size, const number overhead) { (read ? reads : writes)++; });
+
+		vector<bytes> response;
+		oram->multiple(batch, response);
+		ASSERT_EQ(batch.size(), response.size());
+		for (number i = 0; i < batch.size(); i++)
+		{
+			EXPECT_EQ(expected[i], toText(response[i], BLOCK_SIZE));
+		}
+
+		// one read of the union of paths, one combined write-back
+		EXPECT_EQ(1, reads);
+		EXPECT_EQ(1, writes);
+
+		for (auto &&[id, value] : vector<pair<number, string>>{{0, "zero-2"}, {1, "one"}, {2, "two"}})
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(value, toText(returned, BLOCK_SIZE));
+		}
+	}
+
 	TEST_F(ORAMTest, MultiplePut)
 	{
 		vector<block> batch;
@@ -355,6 +461,80 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, AccessError)
+	{
+		// without and with the tree-top cache
+		for (auto &&treeTopSize : vector<number>{0, 3 * Z * (sizeof(number) + BLOCK_SIZE)})
+		{
+			auto map  = make_shared<FailingPositionMap>(CAPACITY * Z + Z);
+			auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), true, BATCH_SIZE, treeTopSize);
+
+			for (number id = 0; id < CAPACITY; id++)
+			{
+				oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+			}
+
+			// the paths are read, then the evictions fail
+			map->failing = true;
+			for (number id = 0; id < CAPACITY; id += 4)
+			{
+				bytes returned;
+				ASSERT_ANY_THROW(oram->get(id, returned));
+			}
+			map->failing = false;
+
+			// no bucket is left with IDs but without payloads
+			for (auto &&[location, bucket] : oram->cache.all())
+			{
+				for (auto &&[id, payload] : bucket)
+				{
+					EXPECT_EQ(BLOCK_SIZE, payload.size());
+				}
+			}
+			for (number location = 1; location < oram->treeTop.size(); location++)
+			{
+				for (auto &&[id, payload] : oram->treeTop[location])
+				{
+					EXPECT_EQ(BLOCK_SIZE, payload.size());
+				}
+			}
+
+			for (auto round = 0; round < 3; round++)
+			{
+				for (number id = 0; id < CAPACITY; id++)
+				{
+					bytes returned;
+					oram->get(id, returned);
+					EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+				}
+			}
+		}
+	}
+
+	TEST_F(ORAMTest, FlatStash)
+	{
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z), make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<FlatStashAdapter>(3 * LOG_CAPACITY * Z, BLOCK_SIZE), true, BATCH_SIZE);
+
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY * Z - 5; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+			if (batch.size() == BATCH_SIZE || id == CAPACITY * Z - 6)
+			{
+				vector<bytes> response;
+				oram->multiple(batch, response);
+				batch.clear();
+			}
+		}
+
+		for (number id = 0; id < CAPACITY * Z - 5; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
 	TEST_F(ORAMTest, BulkLoad)
 	{
 		vector<block> batch;
@@ -412,25 +592,366 @@ namespace PathORAM
 		EXPECT_EQ(0, *min_element(puts.begin(), puts.end()));
 	}
 
-	TEST_F(ORAMTest, LeavesForLocation)
+	TEST_F(ORAMTest, TreeTopLevels)
 	{
-		const auto HEIGHT = 5;
+		const auto bucketSize = Z * (sizeof(number) + BLOCK_SIZE);
+
+		EXPECT_EQ(0, ORAM::levelsForTreeTop(0, LOG_CAPACITY, Z, BLOCK_SIZE));
+		EXPECT_EQ(0, ORAM::levelsForTreeTop(bucketSize - 1, LOG_CAPACITY, Z, BLOCK_SIZE));
+		EXPECT_EQ(1, ORAM::levelsForTreeTop(bucketSize, LOG_CAPACITY, Z, BLOCK_SIZE));
+		EXPECT_EQ(2, ORAM::levelsForTreeTop(3 * bucketSize, LOG_CAPACITY, Z, BLOCK_SIZE));
+		EXPECT_EQ(2, ORAM::levelsForTreeTop(6 * bucketSize, LOG_CAPACITY, Z, BLOCK_SIZE));
+		EXPECT_EQ(LOG_CAPACITY, ORAM::levelsForTreeTop(ULLONG_MAX / 2, LOG_CAPACITY, Z, BLOCK_SIZE));
+	}
 
-		auto smallOram = make_unique<ORAM>(HEIGHT, BLOCK_SIZE, Z);
-		for (auto location = 1; location < (1 << HEIGHT); location++)
+	TEST_F(ORAMTest, DeterministicEviction)
+	{
+		for (auto &&rate : vector<number>{1, 2})
 		{
-			const auto [left, right] = smallOram->leavesForLocation(location);
-			const auto level		 = (number)floor(log2(location));
+			auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z), make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), true, 1, 0, rate);
+
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
+			{
+				oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+			}
+
+			// one eviction every rate accesses
+			EXPECT_EQ(CAPACITY * Z / 2 / rate, oram->evictions);
 
-			for (auto leaf = left; leaf <= right; leaf++)
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
+			{
+				bytes returned;
+				oram->get(id, returned);
+				EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+			}
+
+			// pipelined accesses follow the same eviction schedule
+			vector<block> requests;
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
+			{
+				requests.push_back({id, bytes()});
+			}
+			vector<bytes> response;
+			oram->pipeline(requests, response);
+			EXPECT_EQ(3 * CAPACITY * Z / 2 / rate, oram->evictions);
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
 			{
-				EXPECT_EQ(location, smallOram->bucketForLevelLeaf(level, leaf));
-				for (auto anotherLeaf = left; anotherLeaf <= right; anotherLeaf++)
+				EXPECT_EQ(to_string(id), toText(response[id], BLOCK_SIZE));
+			}
+		}
+	}
+
+	TEST_F(ORAMTest, AsyncWriteBack)
+	{
+		using ::testing::NiceMock;
+
+		const auto LIMIT = 2uLL;
+
+		auto storage = make_shared<NiceMock<MockStorage>>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z, 0);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, true, 1, 0, 0, LIMIT);
+
+		// slow writes keep the write-backs in flight
+		storage->delay = chrono::milliseconds(1);
+
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+
+			lock_guard<mutex> guard(oram->pendingLock);
+			ASSERT_LE(oram->pending.size(), LIMIT);
+		}
+
+		// buckets still in flight are read from the pending write-backs
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		// destructor finishes the write-backs
+		oram.reset();
+		storage->delay = chrono::milliseconds(0);
+		oram		   = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, false);
+
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, AsyncWriteBackError)
+	{
+		using ::testing::NiceMock;
+
+		auto storage = make_shared<NiceMock<MockStorage>>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z, 0);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, true, 1, 0, 0, 2);
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// the failed write-back is reported, and it stays pending (readable) instead of being dropped
+		oram->flushWriteBack();
+		storage->failing = true;
+		oram->put(CAPACITY, fromText(to_string(CAPACITY), BLOCK_SIZE));
+		ASSERT_ANY_THROW(oram->flushWriteBack());
+		{
+			lock_guard<mutex> guard(oram->pendingLock);
+			ASSERT_EQ(1, oram->pending.size());
+		}
+
+		bytes returned;
+		try
+		{
+			// the access is served, its write-back may report the failure of the retry
+			oram->get(CAPACITY, returned);
+		}
+		catch (const Exception &)
+		{
+		}
+		EXPECT_EQ(to_string(CAPACITY), toText(returned, BLOCK_SIZE));
+
+		// once the storage is back, the failed write-backs are retried and nothing is lost
+		storage->failing = false;
+		try
+		{
+			oram->flushWriteBack(); // may report a retry that started before the storage was back
+		}
+		catch (const Exception &)
+		{
+		}
+		ASSERT_NO_THROW(oram->flushWriteBack());
+		for (number id = 0; id <= CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		oram.reset();
+		oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, false);
+		for (number id = 0; id <= CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, Pipeline)
+	{
+		using ::testing::NiceMock;
+
+		// storage with concurrent GET and SET, and storage with serialized calls; synchronous and asynchronous write-back
+		for (auto &&[concurrent, writeBackLimit] : vector<pair<bool, number>>{{true, 0}, {false, 0}, {true, 2}, {false, 2}})
+		{
+			auto storage = concurrent ?
+							   shared_ptr<AbsStorageAdapter>(make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z)) :
+							   shared_ptr<AbsStorageAdapter>(make_shared<NiceMock<MockStorage>>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z, 0));
+			auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), true, 1, 0, 0, writeBackLimit);
+
+			vector<block> requests;
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
+			{
+				requests.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+			}
+			// duplicates are served in order
+			requests.push_back({0, bytes()});
+			requests.push_back({0, fromText("updated", BLOCK_SIZE)});
+			requests.push_back({0, bytes()});
+
+			vector<bytes> response;
+			oram->pipeline(requests, response);
+			ASSERT_EQ(requests.size(), response.size());
+			EXPECT_EQ("0", toText(response[CAPACITY * Z / 2], BLOCK_SIZE));
+			EXPECT_EQ("updated", toText(response[CAPACITY * Z / 2 + 2], BLOCK_SIZE));
+
+			requests.clear();
+			for (number id = 1; id < CAPACITY * Z / 2; id++)
+			{
+				requests.push_back({id, bytes()});
+			}
+			response.clear();
+			oram->pipeline(requests, response);
+			for (number i = 0; i < requests.size(); i++)
+			{
+				EXPECT_EQ(to_string(requests[i].first), toText(response[i], BLOCK_SIZE));
+			}
+		}
+	}
+
+	TEST_F(ORAMTest, PipelineOverlap)
+	{
+		using ::testing::NiceMock;
+
+		auto storage = make_shared<NiceMock<MockStorage>>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z, 0);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), stash);
+
+		vector<block> requests;
+		for (number id = 0; id < BATCH_SIZE; id++)
+		{
+			requests.push_back({id, bytes()});
+		}
+
+		storage->reads.clear();
+		vector<bytes> response;
+		oram->pipeline(requests, response);
+
+		// the root is shared by all paths, it is downloaded once and then kept in the cache
+		EXPECT_EQ(1, count(storage->reads.begin(), storage->reads.end(), 1uLL));
+		EXPECT_LE(storage->reads.size(), BATCH_SIZE * LOG_CAPACITY - (BATCH_SIZE - 1));
+	}
+
+	TEST_F(ORAMTest, TreeTopCache)
+	{
+		using ::testing::_;
+		using ::testing::An;
+		using ::testing::AnyNumber;
+		using ::testing::NiceMock;
+		using ::testing::Truly;
+
+		const auto levels	   = 2uLL;
+		const auto bucketSize  = Z * (sizeof(number) + BLOCK_SIZE);
+		const auto treeTopSize = ((1 << levels) - 1) * bucketSize;
+
+		auto storage = make_shared<NiceMock<MockStorage>>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z, 0);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, true, BATCH_SIZE, treeTopSize);
+
+		// after initialization, the top levels never go to the storage
+		const auto noTopPredicate = [](const vector<number> &locations) -> bool {
+			return all_of(locations.begin(), locations.end(), [](const number location) { return location >= (1 << levels); });
+		};
+		EXPECT_CALL(*storage, getInternal(_, An<vector<bytes> &>())).Times(0);
+		EXPECT_CALL(*storage, getInternal(Truly(noTopPredicate), An<vector<bytes> &>())).Times(AnyNumber());
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		// tree top is written back on destruction, a new ORAM over the same storage reads it
+		::testing::Mock::VerifyAndClearExpectations(storage.get());
+		oram.reset();
+		oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, false, BATCH_SIZE, treeTopSize);
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, ConcurrentFrontEnd)
+	{
+		auto concurrent = make_unique<ConcurrentORAM>(move(oram), BATCH_SIZE);
+
+		const auto threads = 4uLL;
+		const auto perThread = CAPACITY * Z / 2 / threads;
+
+		// each thread owns a range of IDs, puts and reads back its own data
+		vector<thread> workers;
+		for (auto t = 0uLL; t < threads; t++)
+		{
+			workers.emplace_back([&, t]() {
+				vector<future<bytes>> puts;
+				for (auto i = 0uLL; i < perThread; i++)
 				{
-					EXPECT_TRUE(smallOram->canInclude(leaf, anotherLeaf, level));
+					const auto id = t * perThread + i;
+					puts.push_back(concurrent->put(id, fromText(to_string(id), BLOCK_SIZE)));
 				}
-			}
+				for (auto &&put : puts)
+				{
+					put.get();
+				}
+
+				vector<future<bytes>> gets;
+				for (auto i = 0uLL; i < perThread; i++)
+				{
+					gets.push_back(concurrent->get(t * perThread + i));
+				}
+				for (auto i = 0uLL; i < perThread; i++)
+				{
+					EXPECT_EQ(to_string(t * perThread + i), toText(gets[i].get(), BLOCK_SIZE));
+				}
+			});
+		}
+		for (auto &&worker : workers)
+		{
+			worker.join();
+		}
+
+		// order of requests is preserved
+		auto first	= concurrent->put(0, fromText("first", BLOCK_SIZE));
+		auto second = concurrent->put(0, fromText("second", BLOCK_SIZE));
+		auto read	= concurrent->get(0);
+		EXPECT_EQ("second", toText(read.get(), BLOCK_SIZE));
+
+		ASSERT_ANY_THROW(concurrent->put(0, bytes()));
+		ASSERT_ANY_THROW(make_unique<ConcurrentORAM>(make_shared<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z), 0));
+
+		// a batch must fit into ORAM::multiple
+		ASSERT_ANY_THROW(make_unique<ConcurrentORAM>(make_shared<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z), 2));
+		ASSERT_NO_THROW(make_unique<ConcurrentORAM>(make_shared<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z), 1));
+	}
+
+	TEST_F(ORAMTest, ConcurrentFrontEndErrors)
+	{
+		auto concurrent = make_unique<ConcurrentORAM>(move(oram), BATCH_SIZE);
+
+		// out of bounds block is rejected before it can fail the batch of other requests
+		ASSERT_ANY_THROW(concurrent->get(CAPACITY * Z * 100));
+		ASSERT_ANY_THROW(concurrent->put(CAPACITY * Z, fromText("bad", BLOCK_SIZE)));
+
+		// the worker survives
+		auto put = concurrent->put(1, fromText("ok", BLOCK_SIZE));
+		EXPECT_EQ("ok", toText(put.get(), BLOCK_SIZE));
+	}
+
+	TEST_F(ORAMTest, BucketCache)
+	{
+		BucketCache cache(LOG_CAPACITY);
+		EXPECT_EQ(nullptr, cache.find(1));
+
+		// two paths sharing the top levels, inserted leaf first
+		vector<number> locations = {16, 8, 4, 2, 1, 31, 15, 7, 3};
+		for (auto &&location : locations)
+		{
+			cache[location].push_back({location * 10, bytes()});
+		}
+		cache[2].push_back({0, bytes()});
+
+		ASSERT_EQ(locations.size(), cache.size());
+		for (auto &&location : locations)
+		{
+			ASSERT_NE(nullptr, cache.find(location));
+			EXPECT_EQ(location * 10, cache.find(location)->front().first);
 		}
+		EXPECT_EQ(2, cache.find(2)->size());
+		EXPECT_EQ(nullptr, cache.find(5));
+		EXPECT_EQ(nullptr, cache.find(30));
+
+		// contiguous in the order of insertion
+		for (number i = 0; i < locations.size(); i++)
+		{
+			EXPECT_EQ(locations[i], cache.all()[i].first);
+		}
+
+		cache.clear();
+		EXPECT_EQ(0, cache.size());
+		EXPECT_EQ(nullptr, cache.find(16));
 	}
 }
 
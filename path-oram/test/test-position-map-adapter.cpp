@@ -15,7 +15,11 @@ namespace PathORAM
 	enum TestingPositionMapAdapterType
 	{
 		PositionMapAdapterTypeInMemory,
-		PositionMapAdapterTypeORAM
+		PositionMapAdapterTypeORAM,
+		PositionMapAdapterTypePacked,
+		PositionMapAdapterTypePackedMapped,
+		PositionMapAdapterTypeORAMPacked,
+		PositionMapAdapterTypeORAMRecursive
 	};
 
 	class PositionMapAdapterTest : public testing::TestWithParam<TestingPositionMapAdapterType>
@@ -26,8 +30,12 @@ namespace PathORAM
 		inline static const number Z		  = 3;
 		inline static const number BLOCK_SIZE = 2 * AES_BLOCK_SIZE;
 
+		// leaves of 6 bits, enough for the values used in tests
+		inline static const number LOG_CAPACITY = 7;
+		inline static const string FILE_NAME	= "position-map-packed.bin";
+
 		protected:
-		unique_ptr<AbsPositionMapAdapter> adapter;
+		shared_ptr<AbsPositionMapAdapter> adapter;
 
 		PositionMapAdapterTest()
 		{
@@ -50,10 +58,38 @@ namespace PathORAM
 							make_unique<InMemoryPositionMapAdapter>(capacity * Z + Z),
 							make_unique<InMemoryStashAdapter>(3 * logCapacity * Z)));
 					break;
+				case PositionMapAdapterTypeORAMPacked:
+					// 4 leaves per block, the smallest tree is enough
+					this->adapter = make_unique<ORAMPositionMapAdapter>(
+						make_unique<ORAM>(
+							3,
+							BLOCK_SIZE,
+							Z,
+							make_unique<InMemoryStorageAdapter>((1 << 3) * Z + Z, BLOCK_SIZE, bytes(), Z),
+							make_unique<InMemoryPositionMapAdapter>((1 << 3) * Z + Z),
+							make_unique<InMemoryStashAdapter>(3 * 3 * Z)),
+						BLOCK_SIZE / sizeof(number));
+					break;
+				case PositionMapAdapterTypeORAMRecursive:
+					// 10 entries, 4 per block: levels of 10, 3 and 1 entries
+					this->adapter = ORAMPositionMapAdapter::recursive(CAPACITY, BLOCK_SIZE, Z, 1);
+					break;
+				case PositionMapAdapterTypePacked:
+					this->adapter = make_unique<PackedPositionMapAdapter>(CAPACITY, LOG_CAPACITY);
+					break;
+				case PositionMapAdapterTypePackedMapped:
+					this->adapter = make_unique<PackedPositionMapAdapter>(CAPACITY, LOG_CAPACITY, FILE_NAME);
+					break;
 				default:
 					throw Exception(boost::format("TestingPositionMapAdapterType %2% is not implemented") % type);
 			}
 		}
+
+		~PositionMapAdapterTest()
+		{
+			adapter.reset();
+			remove(FILE_NAME.c_str());
+		}
 	};
 
 	TEST_P(PositionMapAdapterTest, Initialization)
@@ -108,6 +144,88 @@ namespace PathORAM
 		}
 	}
 
+	TEST_P(PositionMapAdapterTest, GetAndSet)
+	{
+		adapter->set(CAPACITY - 1, 56uLL);
+		adapter->set(CAPACITY - 2, 25uLL);
+
+		EXPECT_EQ(56uLL, adapter->getAndSet(CAPACITY - 1, 12uLL));
+		EXPECT_EQ(12uLL, adapter->get(CAPACITY - 1));
+		EXPECT_EQ(25uLL, adapter->get(CAPACITY - 2));
+	}
+
+	TEST_P(PositionMapAdapterTest, ORAMSingleAccessRemap)
+	{
+		if (GetParam() == PositionMapAdapterTypeORAMPacked)
+		{
+			auto storage = make_shared<InMemoryStorageAdapter>(64 * Z + Z, BLOCK_SIZE, bytes(), Z);
+			auto oram	 = make_shared<ORAM>(6, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(64 * Z + Z), make_shared<InMemoryStashAdapter>(3 * 6 * Z));
+			auto map	 = make_unique<ORAMPositionMapAdapter>(oram, BLOCK_SIZE / sizeof(number));
+
+			auto reads = 0uLL, writes = 0uLL;
+			storage->subscribe([&](const bool read, const number batch, const number size, const number overhead) { (read ? reads : writes)++; });
+
+			// one ORAM access: one path read, one path write
+			map->getAndSet(CAPACITY - 1, 12uLL);
+			EXPECT_EQ(1, reads);
+			EXPECT_EQ(1, writes);
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+
+	TEST_P(PositionMapAdapterTest, PackedWidth)
+	{
+		if (GetParam() == PositionMapAdapterTypePacked)
+		{
+			// 13-bit entries straddle word boundaries
+			const auto capacity = 1000uLL;
+			auto map			= make_unique<PackedPositionMapAdapter>(capacity, 14);
+			ASSERT_EQ(13, map->width);
+
+			vector<number> expected;
+			for (number i = 0; i < capacity; i++)
+			{
+				expected.push_back(getRandomULong(1 << 13));
+				map->set(i, expected.back());
+			}
+			for (number i = 0; i < capacity; i++)
+			{
+				ASSERT_EQ(expected[i], map->get(i));
+			}
+
+			ASSERT_ANY_THROW(map->set(0, 1 << 13));
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+
+	TEST_P(PositionMapAdapterTest, PackedPersistence)
+	{
+		if (GetParam() == PositionMapAdapterTypePackedMapped)
+		{
+			adapter->set(CAPACITY - 1, 56uLL);
+			adapter->set(CAPACITY - 2, 25uLL);
+			adapter.reset();
+
+			// wrong geometry
+			ASSERT_ANY_THROW(make_unique<PackedPositionMapAdapter>(CAPACITY * 2, LOG_CAPACITY, FILE_NAME, false));
+			ASSERT_ANY_THROW(make_unique<PackedPositionMapAdapter>(CAPACITY, LOG_CAPACITY, "/error/path/should/not/exist", false));
+
+			auto map = make_unique<PackedPositionMapAdapter>(CAPACITY, LOG_CAPACITY, FILE_NAME, false);
+			EXPECT_EQ(56uLL, map->get(CAPACITY - 1));
+			EXPECT_EQ(25uLL, map->get(CAPACITY - 2));
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+
 	TEST_P(PositionMapAdapterTest, BlockOutOfBounds)
 	{
 		ASSERT_ANY_THROW(adapter->get(CAPACITY * 100));
@@ -144,12 +262,20 @@ namespace PathORAM
 				return "InMemory";
 			case PositionMapAdapterTypeORAM:
 				return "ORAM";
+			case PositionMapAdapterTypeORAMPacked:
+				return "ORAMPacked";
+			case PositionMapAdapterTypeORAMRecursive:
+				return "ORAMRecursive";
+			case PositionMapAdapterTypePacked:
+				return "Packed";
+			case PositionMapAdapterTypePackedMapped:
+				return "PackedMapped";
 			default:
 				throw Exception(boost::format("TestingPositionMapAdapterType %2% is not implemented") % input.param);
 		}
 	}
 
-	INSTANTIATE_TEST_SUITE_P(PositionMapSuite, PositionMapAdapterTest, testing::Values(PositionMapAdapterTypeInMemory, PositionMapAdapterTypeORAM), printTestName);
+	INSTANTIATE_TEST_SUITE_P(PositionMapSuite, PositionMapAdapterTest, testing::Values(PositionMapAdapterTypeInMemory, PositionMapAdapterTypeORAM, PositionMapAdapterTypePacked, PositionMapAdapterTypePackedMapped, PositionMapAdapterTypeORAMPacked, PositionMapAdapterTypeORAMRecursive), printTestName);
 }
 
 int main(int argc, char** argv)
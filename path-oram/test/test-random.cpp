@@ -0,0 +1,117 @@
+#include "definitions.h"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+#include <set>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// this test is compiled without TESTING and DEBUG (see Makefile),
+// so that the per-thread buffer of OpenSSL PRG output is exercised
+
+namespace PathORAM
+{
+	class RandomTest : public ::testing::Test
+	{
+		protected:
+		// true if the region is not all zeros (handed out bytes are wiped from the buffer)
+		static bool nonZero(const bytes &material)
+		{
+			return any_of(material.begin(), material.end(), [](uchar value) { return value != 0x00; });
+		}
+	};
+
+#if !defined(TESTING) && !defined(DEBUG)
+	TEST_F(RandomTest, StraddleRefill)
+	{
+		const auto SIZE = 100uLL;
+
+		set<bytes> seen;
+		for (auto offset : vector<number>{0, 1, SIZE / 2, SIZE - 1})
+		{
+			// SIZE does not divide RANDOM_BUFFER_SIZE, so some requests do not fit into what is left in the buffer
+			if (offset > 0)
+			{
+				getRandomBlock(offset);
+			}
+
+			for (number i = 0; i < 2 * RANDOM_BUFFER_SIZE / SIZE; i++)
+			{
+				auto material = getRandomBlock(SIZE);
+				ASSERT_EQ(SIZE, material.size());
+				ASSERT_TRUE(nonZero(material));
+				ASSERT_TRUE(seen.insert(material).second);
+			}
+		}
+	}
+
+	TEST_F(RandomTest, ExactBufferSize)
+	{
+		set<bytes> seen;
+		for (auto size : vector<number>{RANDOM_BUFFER_SIZE - 1, RANDOM_BUFFER_SIZE, RANDOM_BUFFER_SIZE + 1})
+		{
+			for (number i = 0; i < 3; i++)
+			{
+				auto material = getRandomBlock(size);
+				ASSERT_EQ(size, material.size());
+				ASSERT_TRUE(nonZero(material));
+				ASSERT_TRUE(seen.insert(material).second);
+
+				// small requests around the large ones are served from the buffer
+				auto small = getRandomBlock(16);
+				ASSERT_TRUE(nonZero(small));
+				ASSERT_TRUE(seen.insert(small).second);
+			}
+		}
+	}
+
+	TEST_F(RandomTest, ForkDoesNotReplay)
+	{
+		const auto SIZE = 32uLL;
+
+		// leave most of the buffer unused, so that the child would replay it
+		getRandomBlock(SIZE);
+
+		int channel[2];
+		ASSERT_EQ(0, pipe(channel));
+
+		auto child = fork();
+		ASSERT_NE(-1, child);
+		if (child == 0)
+		{
+			auto material = getRandomBlock(SIZE);
+			auto written  = write(channel[1], material.data(), SIZE);
+			_exit(written == (ssize_t)SIZE ? 0 : 1);
+		}
+		close(channel[1]);
+
+		auto parent = getRandomBlock(SIZE);
+
+		bytes received(SIZE);
+		number total = 0;
+		while (total < SIZE)
+		{
+			auto count = read(channel[0], received.data() + total, SIZE - total);
+			ASSERT_GT(count, 0);
+			total += count;
+		}
+		close(channel[0]);
+
+		int status;
+		ASSERT_EQ(child, waitpid(child, &status, 0));
+		ASSERT_TRUE(WIFEXITED(status));
+		ASSERT_EQ(0, WEXITSTATUS(status));
+
+		EXPECT_TRUE(nonZero(received));
+		EXPECT_NE(parent, received);
+	}
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
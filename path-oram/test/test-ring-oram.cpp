@@ -0,0 +1,303 @@
+#include "definitions.h"
+#include "ring-oram.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace PathORAM
+{
+	// delegates to the in-memory storage, writes throw while failing is set
+	class MockStorage : public AbsStorageAdapter
+	{
+		public:
+		MockStorage(number capacity, number userBlockSize, bytes key, number Z) :
+			AbsStorageAdapter(capacity, userBlockSize, key, Z, 0),
+			_real(make_unique<InMemoryStorageAdapter>(capacity, userBlockSize, key, Z))
+		{
+		}
+
+		virtual void getInternal(const number location, bytes &response) const override
+		{
+			_real->getInternal(location, response);
+		}
+
+		virtual void setInternal(const number location, const bytes &raw) override
+		{
+			if (failing)
+			{
+				throw Exception("storage is unavailable");
+			}
+			_real->setInternal(location, raw);
+		}
+
+		virtual bool supportsBatchGet() const override
+		{
+			return false;
+		}
+
+		virtual bool supportsBatchSet() const override
+		{
+			return false;
+		}
+
+		bool failing = false;
+
+		private:
+		unique_ptr<InMemoryStorageAdapter> _real;
+	};
+
+	class RingORAMTest : public ::testing::Test
+	{
+		public:
+		inline static const number LOG_CAPACITY = 5;
+		inline static const number Z			= 4;
+		inline static const number S			= 5;
+		inline static const number A			= 3;
+		inline static const number BLOCK_SIZE	= 32;
+		inline static const number BATCH_SIZE	= 10;
+
+		inline static const number CAPACITY = (1 << LOG_CAPACITY);
+
+		protected:
+		unique_ptr<RingORAM> oram;
+		shared_ptr<AbsStorageAdapter> storage = make_shared<InMemoryStorageAdapter>(CAPACITY * (Z + S), BLOCK_SIZE, bytes(), 1);
+		shared_ptr<AbsStashAdapter> stash	  = make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z);
+
+		RingORAMTest()
+		{
+			this->oram = make_unique<RingORAM>(
+				LOG_CAPACITY,
+				BLOCK_SIZE,
+				Z,
+				S,
+				A,
+				storage,
+				make_unique<InMemoryPositionMapAdapter>(CAPACITY * Z + Z),
+				stash,
+				BATCH_SIZE);
+		}
+	};
+
+	TEST_F(RingORAMTest, Initialization)
+	{
+		SUCCEED();
+	}
+
+	TEST_F(RingORAMTest, InitializationShorthand)
+	{
+		ASSERT_NO_THROW(auto oram = make_unique<RingORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, S, A));
+	}
+
+	TEST_F(RingORAMTest, InitializationErrors)
+	{
+		ASSERT_ANY_THROW(make_unique<RingORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, 0, A));
+		ASSERT_ANY_THROW(make_unique<RingORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, S, 0));
+	}
+
+	TEST_F(RingORAMTest, OneSlotPerBucket)
+	{
+		vector<number> reads;
+		storage->subscribe([&](const bool read, const number batch, const number size, const number overhead) {
+			if (read)
+			{
+				reads.push_back(batch);
+			}
+		});
+
+		// the first access does not evict and does not reshuffle: one batch of one slot per level
+		bytes returned;
+		oram->get(CAPACITY - 1, returned);
+		ASSERT_EQ(1, reads.size());
+		EXPECT_EQ(LOG_CAPACITY, reads[0]);
+	}
+
+	TEST_F(RingORAMTest, EarlyReshuffle)
+	{
+		for (number i = 0; i < CAPACITY * Z; i++)
+		{
+			bytes returned;
+			oram->get(getRandomULong(CAPACITY * Z / 2), returned);
+
+			// after every access every bucket has a valid dummy left
+			for (number location = 1; location < CAPACITY; location++)
+			{
+				ASSERT_LT(oram->metadata[location].count, S);
+			}
+		}
+	}
+
+	TEST_F(RingORAMTest, GetPutSame)
+	{
+		auto toPut = fromText("hello", BLOCK_SIZE);
+		oram->put(CAPACITY - 1, toPut);
+
+		bytes returned;
+		oram->get(CAPACITY - 1, returned);
+
+		ASSERT_EQ("hello", toText(returned, BLOCK_SIZE));
+	}
+
+	TEST_F(RingORAMTest, PutGetMany)
+	{
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			auto toPut = fromText(to_string(id), BLOCK_SIZE);
+			oram->put(id, toPut);
+		}
+
+		for (auto round = 0; round < 3; round++)
+		{
+			for (number id = 0; id < CAPACITY * Z / 2; id++)
+			{
+				bytes returned;
+				oram->get(id, returned);
+				EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+			}
+		}
+	}
+
+	TEST_F(RingORAMTest, MultipleTooManyRequests)
+	{
+		vector<block> batch;
+		batch.resize(BATCH_SIZE + 1);
+		ASSERT_ANY_THROW({
+			vector<bytes> response;
+			oram->multiple(batch, response);
+		});
+	}
+
+	TEST_F(RingORAMTest, Multiple)
+	{
+		const auto count = CAPACITY * Z / 2;
+
+		vector<block> batch;
+		for (number id = 0; id < count; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+			if (batch.size() == BATCH_SIZE || id == count - 1)
+			{
+				vector<bytes> response;
+				oram->multiple(batch, response);
+				ASSERT_EQ(batch.size(), response.size());
+				for (number i = 0; i < batch.size(); i++)
+				{
+					EXPECT_EQ(batch[i].second, response[i]);
+				}
+				batch.clear();
+			}
+		}
+
+		for (number id = 0; id < count; id++)
+		{
+			batch.push_back({id, bytes()});
+			if (batch.size() == BATCH_SIZE || id == count - 1)
+			{
+				vector<bytes> response;
+				oram->multiple(batch, response);
+				ASSERT_EQ(batch.size(), response.size());
+				for (number i = 0; i < batch.size(); i++)
+				{
+					EXPECT_EQ(to_string(batch[i].first), toText(response[i], BLOCK_SIZE));
+				}
+				batch.clear();
+			}
+		}
+	}
+
+	TEST_F(RingORAMTest, WriteError)
+	{
+		auto storage = make_shared<MockStorage>(CAPACITY * (Z + S), BLOCK_SIZE, bytes(), 1);
+		auto oram	 = make_unique<RingORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, S, A, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), stash);
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// the eviction fails, the buckets keep their old slots and metadata
+		vector<vector<number>> ids;
+		for (auto &&bucket : oram->metadata)
+		{
+			ids.push_back(bucket.ids);
+		}
+		storage->failing = true;
+		auto failed		 = false;
+		for (number id = 0; id < A; id++)
+		{
+			try
+			{
+				oram->put(id, fromText("updated " + to_string(id), BLOCK_SIZE));
+			}
+			catch (const Exception &)
+			{
+				failed = true;
+			}
+		}
+		ASSERT_TRUE(failed);
+		for (number location = 0; location < ids.size(); location++)
+		{
+			EXPECT_EQ(ids[location], oram->metadata[location].ids);
+		}
+		storage->failing = false;
+
+		// no stale copies come back from the buckets that were not written
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ((id < A ? "updated " : "") + to_string(id), toText(returned, BLOCK_SIZE));
+		}
+		for (auto round = 0; round < 5; round++)
+		{
+			for (number id = 0; id < CAPACITY; id++)
+			{
+				oram->put(id, fromText(to_string(round) + " " + to_string(id), BLOCK_SIZE));
+			}
+			for (number id = 0; id < CAPACITY; id++)
+			{
+				bytes returned;
+				oram->get(id, returned);
+				EXPECT_EQ(to_string(round) + " " + to_string(id), toText(returned, BLOCK_SIZE));
+			}
+		}
+	}
+
+	TEST_F(RingORAMTest, BulkLoad)
+	{
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+		}
+
+		oram->load(batch);
+
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(RingORAMTest, BulkLoadTooMany)
+	{
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY * Z + 1; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+		}
+
+		ASSERT_ANY_THROW(oram->load(batch));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
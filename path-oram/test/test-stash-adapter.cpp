@@ -3,26 +3,51 @@
 #include "utility.hpp"
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <boost/format.hpp>
 
 using namespace std;
 
 namespace PathORAM
 {
-	class StashAdapterTest : public ::testing::Test
+	enum TestingStashAdapterType
+	{
+		StashAdapterTypeInMemory,
+		StashAdapterTypeFlat
+	};
+
+	class StashAdapterTest : public testing::TestWithParam<TestingStashAdapterType>
 	{
 		public:
-		inline static const number CAPACITY = 10;
+		inline static const number CAPACITY	  = 10;
+		inline static const number BLOCK_SIZE = 32;
 
 		protected:
-		unique_ptr<InMemoryStashAdapter> adapter = make_unique<InMemoryStashAdapter>(CAPACITY);
+		unique_ptr<AbsStashAdapter> adapter;
+
+		StashAdapterTest()
+		{
+			auto type = GetParam();
+			switch (type)
+			{
+				case StashAdapterTypeInMemory:
+					this->adapter = make_unique<InMemoryStashAdapter>(CAPACITY);
+					break;
+				case StashAdapterTypeFlat:
+					this->adapter = make_unique<FlatStashAdapter>(CAPACITY, BLOCK_SIZE);
+					break;
+				default:
+					throw Exception(boost::format("TestingStashAdapterType %1% is not implemented") % type);
+			}
+		}
 	};
 
-	TEST_F(StashAdapterTest, Initialization)
+	TEST_P(StashAdapterTest, Initialization)
 	{
 		SUCCEED();
 	}
 
-	TEST_F(StashAdapterTest, ReadGetEraseNoCrash)
+	TEST_P(StashAdapterTest, ReadGetEraseNoCrash)
 	{
 		EXPECT_NO_THROW({
 			adapter->add(5uLL, bytes());
@@ -32,8 +57,14 @@ namespace PathORAM
 		});
 	}
 
-	TEST_F(StashAdapterTest, LoadStore)
+	TEST_P(StashAdapterTest, LoadStore)
 	{
+		if (GetParam() != StashAdapterTypeInMemory)
+		{
+			SUCCEED();
+			return;
+		}
+
 		const auto blockSize = 64;
 		const auto filename	 = "stash.bin";
 		const auto expected	 = fromText("hello", blockSize);
@@ -52,15 +83,21 @@ namespace PathORAM
 		remove(filename);
 	}
 
-	TEST_F(StashAdapterTest, LoadStoreFileError)
+	TEST_P(StashAdapterTest, LoadStoreFileError)
 	{
+		if (GetParam() != StashAdapterTypeInMemory)
+		{
+			SUCCEED();
+			return;
+		}
+
 		auto stash = new InMemoryStashAdapter(CAPACITY);
 		ASSERT_ANY_THROW(stash->storeToFile("/error/path/should/not/exist"));
 		ASSERT_ANY_THROW(stash->loadFromFile("/error/path/should/not/exist", 0));
 		delete stash;
 	}
 
-	TEST_F(StashAdapterTest, GetAllShuffle)
+	TEST_P(StashAdapterTest, GetAllShuffle)
 	{
 		for (number i = 0; i < CAPACITY; i++)
 		{
@@ -77,7 +114,7 @@ namespace PathORAM
 		EXPECT_NE(first, second);
 	}
 
-	TEST_F(StashAdapterTest, OverflowAdd)
+	TEST_P(StashAdapterTest, OverflowAdd)
 	{
 		for (number i = 0uLL; i < CAPACITY; i++)
 		{
@@ -89,7 +126,7 @@ namespace PathORAM
 		ASSERT_NO_THROW(adapter->add(CAPACITY + 1, bytes())); // duplicate key should not be inserted
 	}
 
-	TEST_F(StashAdapterTest, OverflowUpdate)
+	TEST_P(StashAdapterTest, OverflowUpdate)
 	{
 		for (number i = 0uLL; i < CAPACITY; i++)
 		{
@@ -101,7 +138,7 @@ namespace PathORAM
 		ASSERT_NO_THROW(adapter->update(CAPACITY + 1, bytes())); // duplicate key should not be inserted
 	}
 
-	TEST_F(StashAdapterTest, ReadWhatWasWritten)
+	TEST_P(StashAdapterTest, ReadWhatWasWritten)
 	{
 		auto block = CAPACITY - 1;
 		auto data  = bytes{0x25};
@@ -113,7 +150,7 @@ namespace PathORAM
 		ASSERT_EQ(data, returned);
 	}
 
-	TEST_F(StashAdapterTest, Override)
+	TEST_P(StashAdapterTest, Override)
 	{
 		auto block = CAPACITY - 1;
 		auto old = bytes{0x25}, _new = bytes{0x56};
@@ -130,7 +167,7 @@ namespace PathORAM
 		ASSERT_EQ(_new, returned);
 	}
 
-	TEST_F(StashAdapterTest, NoOverride)
+	TEST_P(StashAdapterTest, NoOverride)
 	{
 		auto block = CAPACITY - 1;
 		auto old = bytes{0x25}, _new = bytes{0x56};
@@ -146,6 +183,128 @@ namespace PathORAM
 		ASSERT_EQ(1, got.size());
 		ASSERT_EQ(old, returned);
 	}
+
+	TEST_P(StashAdapterTest, ForEach)
+	{
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			adapter->add(i * 3, fromText(to_string(i), BLOCK_SIZE));
+		}
+
+		vector<number> visited;
+		adapter->forEach([&visited](const number block, const uchar *data, const number size) {
+			EXPECT_EQ(to_string(block / 3), toText(bytes(data, data + size), BLOCK_SIZE));
+			visited.push_back(block);
+		});
+
+		sort(visited.begin(), visited.end());
+		ASSERT_EQ(CAPACITY, visited.size());
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			EXPECT_EQ(i * 3, visited[i]);
+		}
+	}
+
+	TEST_P(StashAdapterTest, DeleteReinsert)
+	{
+		// churn through many IDs so that clusters form, wrap around the table and get shifted back on delete
+		vector<number> present;
+		for (number round = 0; round < 1000; round++)
+		{
+			if (present.size() == CAPACITY || (present.size() > 0 && getRandomULong(2) == 0))
+			{
+				auto index = getRandomULong(present.size());
+				adapter->deleteBlock(present[index]);
+				present.erase(present.begin() + index);
+			}
+			else
+			{
+				auto id = getRandomULong(CAPACITY * 10);
+				if (find(present.begin(), present.end(), id) == present.end())
+				{
+					adapter->add(id, fromText(to_string(id), BLOCK_SIZE));
+					present.push_back(id);
+				}
+			}
+
+			for (auto &&id : present)
+			{
+				bytes returned;
+				adapter->get(id, returned);
+				ASSERT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+			}
+		}
+	}
+
+	TEST_P(StashAdapterTest, Take)
+	{
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			adapter->add(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		for (number id = 0; id < CAPACITY; id += 2)
+		{
+			// previous content is replaced
+			auto returned = fromText("garbage", BLOCK_SIZE);
+			adapter->take(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		// taken blocks are removed, the rest stay
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			adapter->get(id, returned);
+			if (id % 2 == 0)
+			{
+				EXPECT_EQ(0, returned.size());
+			}
+			else
+			{
+				EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+			}
+		}
+
+		// a missing block gives empty data
+		auto returned = fromText("garbage", BLOCK_SIZE);
+		adapter->take(CAPACITY * 10, returned);
+		EXPECT_EQ(0, returned.size());
+
+		// the freed room can be used again
+		for (number id = 0; id < CAPACITY; id += 2)
+		{
+			EXPECT_NO_THROW(adapter->add(CAPACITY + id, fromText(to_string(id), BLOCK_SIZE)));
+		}
+	}
+
+	TEST_P(StashAdapterTest, FlatTooLarge)
+	{
+		if (GetParam() != StashAdapterTypeFlat)
+		{
+			SUCCEED();
+			return;
+		}
+
+		ASSERT_ANY_THROW(adapter->add(0, bytes(BLOCK_SIZE + 1)));
+		ASSERT_NO_THROW(adapter->add(0, bytes(BLOCK_SIZE)));
+		ASSERT_ANY_THROW(adapter->update(0, bytes(BLOCK_SIZE + 1)));
+	}
+
+	string printTestName(testing::TestParamInfo<TestingStashAdapterType> input)
+	{
+		switch (input.param)
+		{
+			case StashAdapterTypeInMemory:
+				return "InMemory";
+			case StashAdapterTypeFlat:
+				return "Flat";
+			default:
+				throw Exception(boost::format("TestingStashAdapterType %1% is not implemented") % input.param);
+		}
+	}
+
+	INSTANTIATE_TEST_SUITE_P(StashSuite, StashAdapterTest, testing::Values(StashAdapterTypeInMemory, StashAdapterTypeFlat), printTestName);
 }
 
 int main(int argc, char** argv)
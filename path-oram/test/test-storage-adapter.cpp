@@ -3,9 +3,12 @@
 #include "utility.hpp"
 
 #include "gtest/gtest.h"
+#include <atomic>
 #include <boost/format.hpp>
+#include <filesystem>
 #include <fstream>
 #include <openssl/aes.h>
+#include <thread>
 
 using namespace std;
 
@@ -15,12 +18,17 @@ namespace PathORAM
 	{
 #if USE_REDIS
 		StorageAdapterTypeRedis,
+		StorageAdapterTypePipelinedRedis,
 #endif
 #if USE_AEROSPIKE
 		StorageAdapterTypeAerospike,
 #endif
 		StorageAdapterTypeInMemory,
-		StorageAdapterTypeFileSystem
+		StorageAdapterTypeFileSystem,
+		StorageAdapterTypeMappedFileSystem,
+#if USE_IO_URING
+		StorageAdapterTypeIOUring
+#endif
 	};
 
 	class StorageAdapterTest : public testing::TestWithParam<TestingStorageAdapterType>
@@ -56,9 +64,17 @@ namespace PathORAM
 					return make_unique<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z, batchLimit);
 				case StorageAdapterTypeFileSystem:
 					return make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, batchLimit);
+				case StorageAdapterTypeMappedFileSystem:
+					return make_unique<MappedFileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, batchLimit, true, 2);
+#if USE_IO_URING
+				case StorageAdapterTypeIOUring:
+					return make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, batchLimit, 2);
+#endif
 #if USE_REDIS
 				case StorageAdapterTypeRedis:
 					return make_unique<RedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), REDIS_HOST, true, Z, batchLimit);
+				case StorageAdapterTypePipelinedRedis:
+					return make_unique<PipelinedRedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), REDIS_HOST, true, Z, batchLimit, 2);
 #endif
 // #if USE_AEROSPIKE
 // 				case StorageAdapterTypeAerospike:
@@ -74,7 +90,7 @@ namespace PathORAM
 			remove(FILE_NAME.c_str());
 			adapter.reset();
 #if USE_REDIS
-			if (GetParam() == StorageAdapterTypeRedis)
+			if (GetParam() == StorageAdapterTypeRedis || GetParam() == StorageAdapterTypePipelinedRedis)
 			{
 				make_unique<sw::redis::Redis>(REDIS_HOST)->flushall();
 			}
@@ -105,9 +121,17 @@ namespace PathORAM
 			{
 				case StorageAdapterTypeFileSystem:
 					return make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, key, filename, override, Z);
+				case StorageAdapterTypeMappedFileSystem:
+					return make_unique<MappedFileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, key, filename, override, Z);
+#if USE_IO_URING
+				case StorageAdapterTypeIOUring:
+					return make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, key, filename, override, Z);
+#endif
 #if USE_REDIS
 				case StorageAdapterTypeRedis:
 					return make_unique<RedisStorageAdapter>(CAPACITY, BLOCK_SIZE, key, REDIS_HOST, override, Z);
+				case StorageAdapterTypePipelinedRedis:
+					return make_unique<PipelinedRedisStorageAdapter>(CAPACITY, BLOCK_SIZE, key, REDIS_HOST, override, Z);
 #endif
 // #if USE_AEROSPIKE
 // 				case StorageAdapterTypeAerospike:
@@ -153,10 +177,22 @@ namespace PathORAM
 			case StorageAdapterTypeFileSystem:
 				ASSERT_ANY_THROW(make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "tmp.bin", false, Z));
 				break;
+			case StorageAdapterTypeMappedFileSystem:
+				ASSERT_ANY_THROW(make_unique<MappedFileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "tmp.bin", false, Z));
+				break;
+#if USE_IO_URING
+			case StorageAdapterTypeIOUring:
+				ASSERT_ANY_THROW(make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "tmp.bin", false, Z));
+				ASSERT_ANY_THROW(make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, 0, 0));
+				break;
+#endif
 #if USE_REDIS
 			case StorageAdapterTypeRedis:
 				ASSERT_ANY_THROW(make_unique<RedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "error", false, Z));
 				break;
+			case StorageAdapterTypePipelinedRedis:
+				ASSERT_ANY_THROW(make_unique<PipelinedRedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "error", false, Z));
+				break;
 #endif
 // #if USE_AEROSPIKE
 // 			case StorageAdapterTypeAerospike:
@@ -169,6 +205,154 @@ namespace PathORAM
 		}
 	}
 
+#if USE_IO_URING
+	TEST_P(StorageAdapterTest, IOUringNoLeakOnError)
+	{
+		if (GetParam() == StorageAdapterTypeIOUring)
+		{
+			const auto openFiles = []() {
+				return distance(filesystem::directory_iterator("/proc/self/fd"), filesystem::directory_iterator());
+			};
+
+			// the file is too small, the constructor throws after opening it
+			{
+				fstream small("tmp.bin", fstream::out | fstream::binary | fstream::trunc);
+			}
+			const auto before = openFiles();
+			for (auto i = 0; i < 10; i++)
+			{
+				ASSERT_ANY_THROW(make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), "tmp.bin", false, Z));
+			}
+			EXPECT_EQ(before, openFiles());
+
+			remove("tmp.bin");
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+
+	TEST_P(StorageAdapterTest, IOUringFailedBatchDrained)
+	{
+		if (GetParam() == StorageAdapterTypeIOUring)
+		{
+			auto uring	   = make_unique<IOUringStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, 0, 4);
+			const auto size = filesystem::file_size(FILE_NAME);
+
+			vector<vector<block>> buckets;
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				buckets.push_back(generateBucket(i * Z));
+				uring->set(i, buckets.back());
+			}
+
+			// the last bucket is cut off, reading it is a short transfer
+			filesystem::resize_file(FILE_NAME, size / CAPACITY * (CAPACITY - 1));
+			vector<block> got;
+			ASSERT_ANY_THROW(uring->get(vector<number>{CAPACITY - 1, 0, 1}, got));
+
+			// completions of the failed batch are not mistaken for those of the next one
+			for (auto i = 0; i < 10; i++)
+			{
+				got.clear();
+				uring->get(vector<number>{2, 3}, got);
+				vector<block> expected(buckets[2]);
+				expected.insert(expected.end(), buckets[3].begin(), buckets[3].end());
+				ASSERT_EQ(expected, got);
+			}
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+#endif
+
+	TEST_P(StorageAdapterTest, FileFormatCompatible)
+	{
+		if (GetParam() == StorageAdapterTypeMappedFileSystem)
+		{
+			auto bucket = generateBucket(5);
+			auto key	= getRandomBlock(KEYSIZE);
+
+			string filename = "tmp.bin";
+			auto mapped		= make_unique<MappedFileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, key, filename, true, Z);
+			mapped->set(CAPACITY - 1, bucket);
+			mapped.reset();
+
+			auto plain = make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, key, filename, false, Z);
+			vector<block> got;
+			plain->get(CAPACITY - 1, got);
+			ASSERT_EQ(bucket, got);
+
+			remove(filename.c_str());
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+
+#if USE_REDIS
+	TEST_P(StorageAdapterTest, PipelinedRedisDeferredWrites)
+	{
+		if (GetParam() == StorageAdapterTypePipelinedRedis)
+		{
+			auto pipelined = static_cast<PipelinedRedisStorageAdapter *>(adapter.get());
+			auto bucket	   = generateBucket(5);
+
+			// deferred write is read back through the same pipeline
+			pipelined->set(CAPACITY - 1, bucket);
+			vector<block> got;
+			pipelined->get(CAPACITY - 1, got);
+			ASSERT_EQ(bucket, got);
+
+			// a write of a thread that never reads is seen by the next read of another thread
+			thread writer([&]() {
+				pipelined->set(CAPACITY - 2, bucket);
+			});
+			writer.join();
+
+			got.clear();
+			pipelined->get(CAPACITY - 2, got);
+			ASSERT_EQ(bucket, got);
+
+			// concurrent readers never see a version older than the one written before their read started
+			atomic<number> written = 0;
+			thread versions([&]() {
+				for (number version = 1; version <= 100; version++)
+				{
+					pipelined->set(CAPACITY - 3, generateBucket(version * Z));
+					written = version;
+				}
+			});
+			vector<thread> readers;
+			for (auto r = 0; r < 2; r++)
+			{
+				readers.emplace_back([&]() {
+					while (written < 100)
+					{
+						const number before = written;
+						vector<block> read;
+						pipelined->get(CAPACITY - 3, read);
+						EXPECT_LE(before * Z, read[0].first);
+					}
+				});
+			}
+			versions.join();
+			for (auto &&reader : readers)
+			{
+				reader.join();
+			}
+		}
+		else
+		{
+			SUCCEED();
+		}
+	}
+#endif
+
 	TEST_P(StorageAdapterTest, InputsCheck)
 	{
 		ASSERT_ANY_THROW(make_unique<InMemoryStorageAdapter>(CAPACITY, AES_BLOCK_SIZE, bytes(), Z));
@@ -236,6 +420,44 @@ namespace PathORAM
 		ASSERT_EQ(bucket, returned);
 	}
 
+	TEST_P(StorageAdapterTest, ConcurrentGetSet)
+	{
+		if (!adapter->supportsConcurrentGetSet())
+		{
+			SUCCEED();
+			return;
+		}
+
+		// the writer uses the lower half of locations, the reader the upper half
+		const auto half = CAPACITY / 2;
+		for (auto location = half; location < CAPACITY; location++)
+		{
+			adapter->set(location, generateBucket(location * Z));
+		}
+
+		auto writer = thread([&]() {
+			for (auto round = 0; round < 100; round++)
+			{
+				for (auto location = 0uLL; location < half; location++)
+				{
+					adapter->set(location, generateBucket(round));
+				}
+			}
+		});
+
+		for (auto round = 0; round < 100; round++)
+		{
+			for (auto location = half; location < CAPACITY; location++)
+			{
+				vector<block> returned;
+				adapter->get(location, returned);
+				ASSERT_EQ(generateBucket(location * Z), returned);
+			}
+		}
+
+		writer.join();
+	}
+
 	// if get/set internal for batching are implemented, they are used
 	// but get/set internal single still has to work
 	TEST_P(StorageAdapterTest, GetSetInternal)
@@ -250,6 +472,24 @@ namespace PathORAM
 		ASSERT_EQ(data, returned);
 	}
 
+	TEST_P(StorageAdapterTest, GetSetInternalContiguous)
+	{
+		const auto blockSize = Z * (BLOCK_SIZE + AES_BLOCK_SIZE) + AES_BLOCK_SIZE;
+		const auto locations = vector<number>{CAPACITY - 1, 0, CAPACITY / 2};
+
+		auto data = getRandomBlock(locations.size() * blockSize);
+
+		adapter->setInternal(locations, data.data());
+		bytes returned(locations.size() * blockSize);
+		adapter->getInternal(locations, returned.data());
+
+		ASSERT_EQ(data, returned);
+
+		bytes single;
+		adapter->getInternal(0, single);
+		ASSERT_EQ(bytes(data.begin() + blockSize, data.begin() + 2 * blockSize), single);
+	}
+
 	TEST_P(StorageAdapterTest, OverrideData)
 	{
 		auto bucket = generateBucket(5);
@@ -441,9 +681,17 @@ namespace PathORAM
 				return "InMemory";
 			case StorageAdapterTypeFileSystem:
 				return "FileSystem";
+			case StorageAdapterTypeMappedFileSystem:
+				return "MappedFileSystem";
+#if USE_IO_URING
+			case StorageAdapterTypeIOUring:
+				return "IOUring";
+#endif
 #if USE_REDIS
 			case StorageAdapterTypeRedis:
 				return "Redis";
+			case StorageAdapterTypePipelinedRedis:
+				return "PipelinedRedis";
 #endif
 // #if USE_AEROSPIKE
 // 			case StorageAdapterTypeAerospike:
@@ -456,7 +704,20 @@ namespace PathORAM
 
 	vector<TestingStorageAdapterType> cases()
 	{
-		vector<TestingStorageAdapterType> result = {StorageAdapterTypeFileSystem, StorageAdapterTypeInMemory};
+		vector<TestingStorageAdapterType> result = {StorageAdapterTypeFileSystem, StorageAdapterTypeMappedFileSystem, StorageAdapterTypeInMemory};
+
+#if USE_IO_URING
+		try
+		{
+			// test if io_uring is available (may be disabled by the kernel or a sandbox)
+			make_unique<IOUringStorageAdapter>(1, PathORAM::StorageAdapterTest::BLOCK_SIZE, bytes(), PathORAM::StorageAdapterTest::FILE_NAME, true, PathORAM::StorageAdapterTest::Z);
+			result.push_back(StorageAdapterTypeIOUring);
+		}
+		catch (...)
+		{
+		}
+		remove(PathORAM::StorageAdapterTest::FILE_NAME.c_str());
+#endif
 
 #if USE_REDIS
 		for (auto host : vector<string>{"127.0.0.1", "redis"})
@@ -467,6 +728,7 @@ namespace PathORAM
 				auto connection = "tcp://" + host + ":6379";
 				make_unique<sw::redis::Redis>(connection)->ping();
 				result.push_back(StorageAdapterTypeRedis);
+				result.push_back(StorageAdapterTypePipelinedRedis);
 				PathORAM::StorageAdapterTest::REDIS_HOST = connection;
 				break;
 			}
@@ -0,0 +1,156 @@
+#include "definitions.h"
+#include "position-map-adapter.hpp"
+#include "tree.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <unordered_map>
+
+using namespace std;
+
+namespace PathORAM
+{
+	class TreeTest : public ::testing::Test
+	{
+		public:
+		inline static const number HEIGHT = 5;
+		inline static const number Z	  = 3;
+
+		protected:
+		Tree tree = Tree(HEIGHT);
+	};
+
+	TEST_F(TreeTest, BucketFromLevelLeaf)
+	{
+		vector<pair<number, vector<number>>> tests =
+			{
+				{6, {1, 2, 5, 11, 22}},
+				{8, {1, 3, 6, 12, 24}},
+				{14, {1, 3, 7, 15, 30}},
+			};
+
+		for (auto &&test : tests)
+		{
+			for (number level = 0; level < HEIGHT; level++)
+			{
+				EXPECT_EQ(test.second[level], tree.bucketForLevelLeaf(level, test.first));
+			}
+		}
+	}
+
+	TEST_F(TreeTest, CanInclude)
+	{
+		vector<tuple<number, number, number, bool>> tests =
+			{
+				{8, 11, 2, true},
+				{8, 11, 3, false},
+				{0, 11, 0, true},
+				{0, 11, 1, false},
+				{0, 11, 2, false},
+			};
+
+		for (auto &&test : tests)
+		{
+			EXPECT_EQ(get<3>(test), tree.canInclude(get<0>(test), get<1>(test), get<2>(test)));
+		}
+	}
+
+	TEST_F(TreeTest, DeepestCommonLevel)
+	{
+		// must agree with canInclude: included on all levels up to the deepest common one, and on none below
+		for (number first = 0; first < (1uLL << (HEIGHT - 1)); first++)
+		{
+			for (number second = 0; second < (1uLL << (HEIGHT - 1)); second++)
+			{
+				const auto deepest = tree.deepestCommonLevel(first, second);
+				ASSERT_LT(deepest, HEIGHT);
+				for (number level = 0; level < HEIGHT; level++)
+				{
+					ASSERT_EQ(level <= deepest, tree.canInclude(first, second, level));
+				}
+			}
+		}
+	}
+
+	TEST_F(TreeTest, ReverseLexicographic)
+	{
+		// 16 leaves, 4 bits reversed
+		vector<number> expected = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15, 0, 8};
+		for (number i = 0; i < expected.size(); i++)
+		{
+			EXPECT_EQ(expected[i], tree.reverseLexicographicLeaf(i));
+		}
+	}
+
+	TEST_F(TreeTest, LeavesForLocation)
+	{
+		for (number location = 1; location < (1uLL << HEIGHT); location++)
+		{
+			const auto [left, right] = tree.leavesForLocation(location);
+			const auto level		 = (number)floor(log2(location));
+
+			for (auto leaf = left; leaf <= right; leaf++)
+			{
+				EXPECT_EQ(location, tree.bucketForLevelLeaf(level, leaf));
+				for (auto anotherLeaf = left; anotherLeaf <= right; anotherLeaf++)
+				{
+					EXPECT_TRUE(tree.canInclude(leaf, anotherLeaf, level));
+				}
+			}
+		}
+	}
+
+	TEST_F(TreeTest, Load)
+	{
+		// the last bucket is incomplete
+		const auto ELEMENTS = (1uLL << (HEIGHT - 1)) * Z + 1;
+
+		vector<block> data;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			data.push_back({id, fromText(to_string(id), 32)});
+		}
+
+		InMemoryPositionMapAdapter map(ELEMENTS);
+		unordered_map<number, number> placed; // block ID -> bucket location
+		vector<number> sizes;
+		tree.load(data, Z, map, [&](const number location, vector<block> &blocks) {
+			ASSERT_GE(location, 1);
+			ASSERT_LT(location, 1uLL << HEIGHT);
+			sizes.push_back(blocks.size());
+			for (auto &&[id, payload] : blocks)
+			{
+				EXPECT_EQ(to_string(id), toText(payload, 32));
+				EXPECT_TRUE(placed.insert({id, location}).second);
+			}
+		});
+
+		// every block is placed once, Z per bucket except the last one
+		ASSERT_EQ(ELEMENTS, placed.size());
+		ASSERT_EQ((ELEMENTS + Z - 1) / Z, sizes.size());
+		for (number i = 0; i + 1 < sizes.size(); i++)
+		{
+			EXPECT_EQ(Z, sizes[i]);
+		}
+		EXPECT_EQ(ELEMENTS % Z, sizes.back());
+
+		// the leaf of a block is below its bucket
+		for (auto &&[id, location] : placed)
+		{
+			EXPECT_TRUE(tree.canInclude(map.get(id), tree.leavesForLocation(location).first, (number)floor(log2(location))));
+		}
+
+		// more than Z blocks per bucket
+		data.resize((1uLL << HEIGHT) * Z + 1, {0, bytes()});
+		ASSERT_ANY_THROW(tree.load(data, Z, map, [](const number, vector<block> &) {}));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -42,6 +42,42 @@ namespace PathORAM
 		ASSERT_EQ(first, second);
 	}
 
+	TEST_F(UtilityTest, FillRandomSameSeed)
+	{
+		const auto n = 20uLL;
+		int seed	 = 0x15;
+
+		srand(seed);
+		auto expected = getRandomBlock(n);
+
+		srand(seed);
+		bytes filled(n);
+		fillRandom(filled.data(), n);
+
+		ASSERT_EQ(expected, filled);
+	}
+
+	TEST_F(UtilityTest, RandomULongsBasicTest)
+	{
+		const auto n   = 10000uLL;
+		const auto max = 100uLL;
+
+		vector<number> samples = {max};
+		getRandomULongs(max, n, samples);
+
+		ASSERT_EQ(n + 1, samples.size());
+		EXPECT_EQ(max, samples[0]);
+
+		auto total = 0.0;
+		for (auto i = 1uLL; i < samples.size(); i++)
+		{
+			EXPECT_LT(samples[i], max);
+			total += samples[i];
+		}
+
+		EXPECT_NEAR((max - 1) / 2.0, total / n, 2);
+	}
+
 	TEST_F(UtilityTest, RandomDoubleBasicTest)
 	{
 		const auto n   = 10000uLL;
@@ -269,6 +305,90 @@ namespace PathORAM
 		});
 	}
 
+	TEST_F(UtilityTest, CipherContextMatchesEncrypt)
+	{
+		for (auto mode : {CBC, CTR, NONE})
+		{
+			__blockCipherMode = mode;
+
+			auto key   = getRandomBlock(KEYSIZE);
+			auto iv	   = getRandomBlock(AES_BLOCK_SIZE);
+			auto input = getRandomBlock(AES_BLOCK_SIZE * 5);
+
+			bytes expected;
+			encrypt(key.begin(), key.end(), iv.begin(), iv.end(), input.begin(), input.end(), expected, ENCRYPT);
+
+			CipherContext context(key);
+			auto material = input;
+			context.crypt(iv.data(), material.data(), material.size(), ENCRYPT);
+			ASSERT_EQ(expected, material);
+
+			context.crypt(iv.data(), material.data(), material.size(), DECRYPT);
+			ASSERT_EQ(input, material);
+		}
+		__blockCipherMode = CBC;
+	}
+
+	TEST_F(UtilityTest, CipherContextRecords)
+	{
+		__blockCipherMode = CBC;
+
+		const auto count = 7uLL, stride = AES_BLOCK_SIZE * 4uLL;
+		auto key		 = getRandomBlock(KEYSIZE);
+		auto buffer		 = getRandomBlock(count * stride);
+		auto original	 = buffer;
+
+		CipherContext context(key);
+		context.crypt(buffer.data(), count, stride, ENCRYPT);
+
+		for (auto i = 0uLL; i < count; i++)
+		{
+			// IVs are untouched, each record is encrypted under its own IV
+			auto record = original.begin() + i * stride;
+			ASSERT_TRUE(equal(record, record + AES_BLOCK_SIZE, buffer.begin() + i * stride));
+
+			bytes expected;
+			encrypt(key.begin(), key.end(), record, record + AES_BLOCK_SIZE, record + AES_BLOCK_SIZE, record + stride, expected, ENCRYPT);
+			ASSERT_TRUE(equal(expected.begin(), expected.end(), buffer.begin() + i * stride + AES_BLOCK_SIZE));
+		}
+
+		context.crypt(buffer.data(), count, stride, DECRYPT);
+		ASSERT_EQ(original, buffer);
+	}
+
+	TEST_F(UtilityTest, CipherContextInputsCheck)
+	{
+		ASSERT_ANY_THROW(CipherContext(getRandomBlock(KEYSIZE - 1)));
+
+		CipherContext context(getRandomBlock(KEYSIZE));
+		auto iv	   = getRandomBlock(AES_BLOCK_SIZE);
+		auto input = getRandomBlock(AES_BLOCK_SIZE + 1);
+		ASSERT_ANY_THROW(context.crypt(iv.data(), input.data(), input.size(), ENCRYPT));
+	}
+
+	TEST_F(UtilityTest, TraceRingBuffer)
+	{
+		traceMessage(TRACE_INFO, "first");
+		traceMessage(TRACE_WARNING, boost::format("second %1%") % 2);
+
+		vector<string> trace;
+		getTrace(trace);
+		ASSERT_LE(2, trace.size());
+		EXPECT_EQ("[INFO] first", trace[trace.size() - 2]);
+		EXPECT_EQ("[WARNING] second 2", trace.back());
+
+		// only the latest TRACE_BUFFER_SIZE messages are kept
+		for (auto i = 0; i < TRACE_BUFFER_SIZE; i++)
+		{
+			traceMessage(TRACE_ACCESS, to_string(i));
+		}
+		trace.clear();
+		getTrace(trace);
+		ASSERT_EQ(TRACE_BUFFER_SIZE, trace.size());
+		EXPECT_EQ("[ACCESS] 0", trace.front());
+		EXPECT_EQ("[ACCESS] " + to_string(TRACE_BUFFER_SIZE - 1), trace.back());
+	}
+
 	TEST_F(UtilityTest, LoadStoreKey)
 	{
 		auto key = getRandomBlock(KEYSIZE);
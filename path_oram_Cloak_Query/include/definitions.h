@@ -22,10 +22,45 @@
 // use 256-bit security
 #define KEYSIZE 32
 
+// AES-GCM nonce size (96 bits, the size GCM uses without hashing the IV)
+#define GCM_IV_SIZE 12
+
 // 256 bit hash size (SHA-256)
 #define HASHSIZE 256
 #define HASH_ALGORITHM EVP_sha256
 
+// compile-time trace levels, anything above TRACE_LEVEL is removed by the preprocessor
+#define TRACE_NONE 0
+#define TRACE_ERROR 1
+#define TRACE_WARNING 2
+#define TRACE_INFO 3
+#define TRACE_ACCESS 4 // every ORAM access, debug builds only
+
+// production builds trace nothing (and pay nothing)
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_NONE
+#endif
+
+// number of the latest trace messages kept in memory (see getTrace)
+#define TRACE_BUFFER_SIZE 1024
+
+// records a message (string or boost::format) in the trace ring buffer if level is enabled
+#if TRACE_LEVEL > TRACE_NONE
+#define TRACE(level, message)                                   \
+	do                                                          \
+	{                                                           \
+		if constexpr ((level) <= TRACE_LEVEL)                   \
+		{                                                       \
+			::CloakQueryPathORAM::traceMessage(level, message); \
+		}                                                       \
+	} while (false)
+#else
+#define TRACE(level, message) \
+	do                        \
+	{                         \
+	} while (false)
+#endif
+
 // change to run all tests from different seed
 #define TEST_SEED 0x13
 
@@ -52,7 +87,8 @@ namespace CloakQueryPathORAM
 	{
 		CBC,
 		CTR,
-		NONE
+		NONE,
+		GCM // authenticated, the storage keeps a tag next to the IV of every bucket
 	};
 
 	// Defining a serialization and deserialization function 
@@ -109,7 +145,6 @@ namespace CloakQueryPathORAM
 		// Debug dialog to check the size of serialized data
 		//std::cout << "Total size of serialized data: " << serializedData.size() << endl; // 768 = 16 * 8 * 6
 		size_t totalTuples = (serializedData.size() / 16) / 8; // 16 for the number of attributes in a tuple, 8 for number of bytes in an int64_t
-		std::cout << "Total number of tuples: " << totalTuples << endl;
 		for (size_t i = 0; i < totalTuples; i++) {
 			vector<int64_t> vec1d;
 			for (size_t j = 0; j < 16; j++) {
@@ -4,7 +4,9 @@
 #include "position-map-adapter.hpp"
 #include "stash-adapter.hpp"
 #include "storage-adapter.hpp"
+#include "utility.hpp"
 
+#include <functional>
 #include <iostream>
 #include <unordered_map>
 #include <unordered_set>
@@ -43,6 +45,9 @@ namespace CloakQueryPathORAM
 		static bytes key; // key used for HMAC generation
 		static bool isKeyGenerated; // Flag to indicate if the key has been generated
 
+		// keyed once with the key, computes bucket MACs without concatenating the payloads
+		unique_ptr<MacContext> macContext;
+
 		// Timing variables
 		mutable long long totalIntegrityCheckTime = 0;
 		mutable long long totalReshuffleTime = 0;
@@ -59,12 +64,42 @@ namespace CloakQueryPathORAM
 		// The number is the bucket ID and the bytes is the MAC
 		unordered_map<number, bytes> macMap;
 
+		// Merkle integrity mode: instead of macMap, the last slot of every bucket holds the hashes of its two children
+		// (so a bucket has Z - 1 slots for data), and the client keeps only the hash of the root
+		const bool merkle;
+		bytes merkleRoot;
+		inline static const number MERKLE_ID = ULONG_MAX - 1; // ID of the slot with the children hashes
+
+		// per-bucket MACs are kept in macMap only if neither Merkle mode, nor authenticated storage (AES-GCM) protects the buckets
+		const bool macs;
+
 		// Store a vector of the secret shares generated by the Shamir Secret sharing class
 		vector<vector<vector<vector<uint64_t>>>> secretShares;
 
 		// Track used block IDs
 		set<number> usedBlockIDs;
 
+		/**
+		 * @brief encodes a container (see encodeContainer) and pads it to a full block
+		 *
+		 * @param container the rows (throws if the encoding does not fit in a block)
+		 * @return bytes the block
+		 */
+		bytes encodeContainerBlock(const vector<vector<int64_t>> &container) const;
+
+		/**
+		 * @brief decodes a block written by putContainer (or in the legacy size-prefixed format)
+		 *
+		 * @param blockData the block
+		 * @return vector<vector<int64_t>> the rows (empty for an empty block)
+		 */
+		vector<vector<int64_t>> decodeContainer(const bytes &blockData) const;
+
+		/**
+		 * @brief runs multiple(...) and adds its time, except integrity checks and reshuffles, to pathRetrievalTime
+		 */
+		void timedMultiple(const vector<block> &requests, vector<bytes> &response);
+
 		/**
 		 * @brief performs a single access, read or write
 		 *
@@ -94,6 +129,32 @@ namespace CloakQueryPathORAM
 		 */
 		void writePath(const number leaf);
 
+		/**
+		 * @brief computes the hash of a bucket (IDs and payloads of all its slots)
+		 *
+		 * @param bucketData the blocks contained within the bucket
+		 * @return bytes the digest (HASHSIZE / 16 bytes)
+		 */
+		bytes bucketDigest(const bucket &bucketData) const;
+
+		/**
+		 * @brief checks a downloaded bucket against the hash kept by its parent (or the client for the root)
+		 *
+		 * The parent has to be in the cache already (it is verified or written by the client).
+		 *
+		 * @param location the bucket location in the tree
+		 * @param bucketData the blocks contained within the bucket
+		 * @return true if the hash matches
+		 */
+		bool verifyBucketHash(const number location, const bucket &bucketData) const;
+
+		/**
+		 * @brief writes the children hashes into every bucket of the tree (bottom-up, level by level) and sets the root hash
+		 *
+		 * Reads and rewrites the whole storage, used after initialization or bulk load.
+		 */
+		void buildMerkleTree();
+
 		/**
 		 * @brief checks if the paths "merge" on the level
 		 *
@@ -152,6 +213,7 @@ namespace CloakQueryPathORAM
 		friend class ORAMTest_ConsistencyCheck_Test;
 		friend class ORAMTest_MultipleCheckCache_Test;
 		friend class ORAMTest_MultipleGetNoDuplicates_Test;
+		friend class ORAMTest_AuthenticatedStoragePutGetMany_Test;
 		friend class ORAMBigTest;
 		friend class ORAMTestSSS;
 		friend class ORAMTestSQL;
@@ -171,6 +233,8 @@ namespace CloakQueryPathORAM
 		 * @param stash pointer to stash adapter to use
 		 * @param initialize whether to initialize map and storage (should be false if map and storage are read from files)
 		 * @param batchSize controls the max number of requests in multiple(...)
+		 * @param merkle whether to check integrity with a Merkle tree (root hash on the client, see setMerkleRoot)
+		 * instead of a MAC per bucket; the last slot of each bucket is then reserved for the children hashes
 		 */
 		ORAM(
 			const number logCapacity,
@@ -180,7 +244,8 @@ namespace CloakQueryPathORAM
 			const shared_ptr<AbsPositionMapAdapter> map,
 			const shared_ptr<AbsStashAdapter> stash,
 			const bool initialize  = true,
-			const number batchSize = 1);
+			const number batchSize = 1,
+			const bool merkle	   = false);
 
 		/**
 		 * @brief Construct a new ORAM object with adapters created automatically
@@ -262,10 +327,10 @@ namespace CloakQueryPathORAM
 
 		// New methods for storing and retrieving vector<vector<vector<int64_t>>>
 		/**
-		 * @brief Convert container to bytes
+		 * @brief Convert container to bytes (see encodeContainer) and put it to the block
 		 *
 		 * @param block the block ID
-		 * @param container the secret shared data to store
+		 * @param container the secret shared data to store (throws if the encoding does not fit in a block)
 		 */
         void putContainer(const number block, const vector<vector<int64_t>> &container);
         
@@ -277,6 +342,45 @@ namespace CloakQueryPathORAM
 		 */
 		vector<vector<int64_t>> getContainer(const number block);
 
+		/**
+		 * @brief Read a container without decoding it to rows
+		 *
+		 * @param block the block ID
+		 * @param storage receives the block, must outlive the view
+		 * @return ContainerView the view over storage (throws if the block does not hold a container)
+		 */
+		ContainerView getContainerView(const number block, bytes &storage);
+
+		/**
+		 * @brief Split a table across consecutive blocks and put them in batches of batchSize (see multiple)
+		 *
+		 * Every block gets as many rows as fit uncompressed, so the number of blocks depends only on the table shape.
+		 *
+		 * @param firstBlock the ID of the first block, the table takes IDs firstBlock, firstBlock + 1, ...
+		 * @param table the rows, all of the same number of attributes
+		 * @return number the number of blocks used
+		 */
+		number putContainers(const number firstBlock, const vector<vector<int64_t>> &table);
+
+		/**
+		 * @brief Read many containers in batches of batchSize (see multiple) and concatenate their rows
+		 *
+		 * @param blocks the block IDs, in order
+		 * @return vector<vector<int64_t>> the rows of all blocks
+		 */
+		vector<vector<int64_t>> getContainers(const vector<number> &blocks);
+
+		/**
+		 * @brief Read many containers in batches of batchSize without decoding them to rows
+		 *
+		 * Only one batch of blocks is held in memory at a time.
+		 * Blocks in the legacy format are decoded and re-encoded; blocks without rows (e.g. empty) are skipped, as in getContainers.
+		 *
+		 * @param blocks the block IDs, in order
+		 * @param visitor called for every block with its ID and a view valid only during the call
+		 */
+		void scanContainers(const vector<number> &blocks, const function<void(const number block, const ContainerView &view)> &visitor);
+
 		/**
 		 * @brief Calculate the MAC for each bucket during ORAM initialization
 		 */
@@ -323,6 +427,16 @@ namespace CloakQueryPathORAM
 		 */
 		void loadMacMap(const std::string &filename);
 
+		/**
+		 * @brief Get the hash of the root of the Merkle tree (to persist along with the storage)
+		 */
+		const bytes &getMerkleRoot() const { return merkleRoot; }
+
+		/**
+		 * @brief Set the hash of the root of the Merkle tree (for storage that was not initialized by this object)
+		 */
+		void setMerkleRoot(const bytes &root) { merkleRoot = root; }
+
 		/**
 		 * @brief Return all used block IDs (those with real data)
 		 */
@@ -5,6 +5,7 @@
 #include <boost/range/any_range.hpp>
 #include <boost/signals2/signal.hpp>
 #include <fstream>
+#include <memory>
 
 // #if USE_REDIS
 // #include <sw/redis++/redis++.h>
@@ -18,6 +19,8 @@ namespace CloakQueryPathORAM
 {
 	using namespace std;
 
+	class GcmContext;
+
 	// range abstraction that is iterable (will be used for vector of pairs and unordered map)
 	using request_anyrange = boost::any_range<pair<const number, bucket>, boost::forward_traversal_tag>;
 
@@ -27,6 +30,8 @@ namespace CloakQueryPathORAM
 	 * The format of the underlying block is the following.
 	 * AES block size (16) bytes of IV, the rest is ciphertext.
 	 * The ciphertext is AES block size (16) of ID (padded), the rest is user's payload.
+	 * In GCM mode (__blockCipherMode at construction), the IV is GCM_IV_SIZE (12) bytes followed by AES block size (16) bytes of authentication tag,
+	 * and the location of the bucket is authenticated along with the ciphertext.
 	 */
 	class AbsStorageAdapter
 	{
@@ -70,11 +75,15 @@ namespace CloakQueryPathORAM
 		const bytes key;		 // AES key for encryption operations
 		const number Z;			 // number of blocks in a bucket
 		const number batchLimit; // maximum number of requests in a batch
+		const bool gcm;			 // buckets are sealed with AES-GCM (IV, tag, ciphertext)
+
+		mutable unique_ptr<GcmContext> sealer; // keyed AES-GCM engine (GCM mode only)
 
 		// Event handler
 		OnStorageRequest onStorageRequest;
 
 		friend class StorageAdapterTest_GetSetInternal_Test;
+		friend class StorageAdapterTest_AuthenticatedTamper_Test;
 		friend class MockStorage;
 
 		public:
@@ -136,6 +145,12 @@ namespace CloakQueryPathORAM
 		 */
 		void fillWithZeroes();
 
+		/**
+		 * @brief whether the buckets are sealed with authenticated encryption (AES-GCM).
+		 * In this case get throws if a bucket was modified or moved to another location.
+		 */
+		bool isAuthenticated() const;
+
 		/**
 		 * @brief whether this adapter supports batch read operations.
 		 */
@@ -168,7 +183,7 @@ namespace CloakQueryPathORAM
 
 		protected:
 		const number capacity;		// number of buckets
-		const number blockSize;		// whole bucket size (Z times (user portion + ID) + IV)
+		const number blockSize;		// whole bucket size (Z times (user portion + ID) + IV, + tag in GCM mode)
 		const number userBlockSize; // number of bytes in payload portion of block
 
 		/**
@@ -2,6 +2,8 @@
 
 #include "definitions.h"
 
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <string>
 
 namespace CloakQueryPathORAM
@@ -71,6 +73,89 @@ namespace CloakQueryPathORAM
 		bytes &output,
 		const EncryptionMode mode);
 
+	/**
+	 * @brief Authenticated encryption routine
+	 *
+	 * Does encryption and authentication (or decryption and verification) in one pass of OpenSSL AES-GCM-256.
+	 * Unlike encrypt, the input does not need to be a multiple of AES block size, and the mode is always GCM.
+	 *
+	 * @param keyFirst the begin() iterator of AES key (must be KEYSIZE bytes)
+	 * @param keyLast the end() iterator of AES key (must be KEYSIZE bytes)
+	 * @param ivFirst the begin() iterator of initialization vector (must be randomly generated, must be GCM_IV_SIZE, 12 bytes)
+	 * @param ivLast the end() iterator of initialization vector (must be randomly generated, must be GCM_IV_SIZE, 12 bytes)
+	 * @param inputFirst the begin() iterator of the plaintext or ciphertext material, without IV and tag
+	 * @param inputLast the end() iterator of the plaintext or ciphertext material, without IV and tag
+	 * @param associated data that is authenticated, but not encrypted (e.g. the location of a bucket), may be empty
+	 * @param tag the authentication tag (AES block size, 16 bytes); written on ENCRYPT, checked on DECRYPT
+	 * @param output vector to put the ciphertext or plaintex material, the result of the encryption operation
+	 * @param mode ENCRYPTION or DECRYPTION
+	 *
+	 * \note
+	 * Throws if on DECRYPT the tag does not match the ciphertext, IV or associated data.
+	 * Expands the key on every call; use GcmContext for many messages under the same key.
+	 */
+	void encryptAuthenticated(
+		const bytes::const_iterator keyFirst,
+		const bytes::const_iterator keyLast,
+		const bytes::const_iterator ivFirst,
+		const bytes::const_iterator ivLast,
+		const bytes::const_iterator inputFirst,
+		const bytes::const_iterator inputLast,
+		const bytes &associated,
+		bytes &tag,
+		bytes &output,
+		const EncryptionMode mode);
+
+	/**
+	 * @brief AES-GCM-256 engine keyed once and reused for many messages
+	 *
+	 * Keeps a keyed cipher context per direction, every message only sets its IV (no key schedule, no allocations per message).
+	 * The result is the same as encryptAuthenticated with the same key.
+	 *
+	 * \note
+	 * The engine is stateful and not thread-safe; use one per thread (or per storage adapter).
+	 */
+	class GcmContext
+	{
+		private:
+		EVP_CIPHER_CTX *encryption = nullptr; // keyed for ENCRYPT
+		EVP_CIPHER_CTX *decryption = nullptr; // keyed for DECRYPT
+
+		public:
+		/**
+		 * @brief Construct a new Gcm Context object
+		 *
+		 * @param key AES key (must be KEYSIZE bytes)
+		 */
+		explicit GcmContext(const bytes &key);
+		~GcmContext();
+
+		GcmContext(const GcmContext &) = delete;
+		GcmContext &operator=(const GcmContext &) = delete;
+
+		/**
+		 * @brief encrypts and authenticates (or decrypts and verifies) a message, as encryptAuthenticated
+		 *
+		 * @param ivFirst the begin() iterator of initialization vector (GCM_IV_SIZE, 12 bytes, never reused with this key)
+		 * @param ivLast the end() iterator of initialization vector
+		 * @param inputFirst the begin() iterator of the plaintext or ciphertext material, without IV and tag
+		 * @param inputLast the end() iterator of the plaintext or ciphertext material, without IV and tag
+		 * @param associated data that is authenticated, but not encrypted, may be empty
+		 * @param tag the authentication tag (AES block size, 16 bytes); written on ENCRYPT, checked on DECRYPT
+		 * @param output vector to append the ciphertext or plaintext material to
+		 * @param mode ENCRYPTION or DECRYPTION
+		 */
+		void encrypt(
+			const bytes::const_iterator ivFirst,
+			const bytes::const_iterator ivLast,
+			const bytes::const_iterator inputFirst,
+			const bytes::const_iterator inputLast,
+			const bytes &associated,
+			bytes &tag,
+			bytes &output,
+			const EncryptionMode mode);
+	};
+
 	/**
 	 * @brief helper to convert string to bytes and pad (from right with zeros)
 	 *
@@ -132,4 +217,155 @@ namespace CloakQueryPathORAM
 	 * @return bytes the hash of the message in bytes
 	 */
 	bytes hmac(const bytes &key, const bytes &input);
+
+	/**
+	 * @brief HMAC engine keyed once and reused for many messages
+	 *
+	 * Keeps a pre-keyed EVP_MAC context, every MAC starts from a duplicate of it (no key schedule per message).
+	 * Payloads are streamed into the MAC, so a bucket is never concatenated into a temporary buffer.
+	 * The result is the same as hmac(key, concatenation of the payloads).
+	 *
+	 * \note
+	 * The engine is stateful and not thread-safe; use one per thread (or per ORAM).
+	 */
+	class MacContext
+	{
+		private:
+		EVP_MAC *mac		= nullptr; // the HMAC algorithm
+		EVP_MAC_CTX *keyed	= nullptr; // initialized with the key once, never updated
+
+		public:
+		/**
+		 * @brief Construct a new Mac Context object
+		 *
+		 * @param key the key used to create the MACs
+		 */
+		explicit MacContext(const bytes &key);
+		~MacContext();
+
+		MacContext(const MacContext &) = delete;
+		MacContext &operator=(const MacContext &) = delete;
+
+		/**
+		 * @brief computes the MAC of the payloads of the first count blocks of a bucket
+		 *
+		 * @param data the bucket
+		 * @param count the number of blocks to include
+		 * @return bytes the MAC
+		 */
+		bytes digest(const bucket &data, const number count);
+
+		/**
+		 * @brief computes the MACs of many buckets at once (e.g. all buckets of a path)
+		 *
+		 * @param data the buckets
+		 * @param count the number of blocks of each bucket to include
+		 * @param output the MACs, in the order of the buckets
+		 */
+		void digests(const vector<const bucket *> &data, const number count, vector<bytes> &output);
+	};
+
+	/**
+	 * @brief encodes a container (rows of int64 attributes) in a packed columnar format
+	 *
+	 * The layout is a header (magic, number of rows, number of attributes),
+	 * a descriptor per column (base and width), then the columns, each starting at an 8-byte boundary.
+	 * A column is stored as value - base in the smallest of 1, 2, 4 or 8 bytes that fits the range of the column
+	 * (frame of reference, this is what keys and dates benefit from); 8-byte columns are the values as is.
+	 *
+	 * @param container the rows, all of the same number of attributes
+	 * @return bytes the encoded container (read it with ContainerView)
+	 */
+	bytes encodeContainer(const vector<vector<int64_t>> &container);
+
+	/**
+	 * @brief the size of encodeContainer output if no column compresses (the upper bound)
+	 *
+	 * @param rows the number of rows
+	 * @param attributes the number of attributes in a row
+	 * @return number the size in bytes
+	 */
+	number encodedContainerSize(const number rows, const number attributes);
+
+	/**
+	 * @brief a read-only view over a container encoded with encodeContainer
+	 *
+	 * The view does not copy the data; the bytes it is constructed from must outlive it.
+	 * Trailing bytes (e.g. the padding of an ORAM block) are ignored.
+	 */
+	class ContainerView
+	{
+		private:
+		const uchar *data;
+		number rowCount;
+		number attributeCount;
+		vector<int64_t> bases;
+		vector<uchar> widths;
+		vector<number> offsets; // of the columns, from data
+
+		public:
+		/**
+		 * @brief Construct a new Container View object
+		 *
+		 * @param encoded the result of encodeContainer (throws if it is not)
+		 */
+		explicit ContainerView(const bytes &encoded);
+
+		/**
+		 * @brief whether the bytes start with the header of encodeContainer
+		 */
+		static bool matches(const bytes &encoded);
+
+		number rows() const { return rowCount; }
+		number attributes() const { return attributeCount; }
+
+		/**
+		 * @brief a single value
+		 *
+		 * @param row the row
+		 * @param attribute the column
+		 * @return int64_t the value
+		 */
+		int64_t at(const number row, const number attribute) const;
+
+		/**
+		 * @brief decodes a whole column (a single memcpy for uncompressed columns)
+		 *
+		 * @param attribute the column
+		 * @param output where to put rows() values
+		 */
+		void column(const number attribute, int64_t *output) const;
+
+		/**
+		 * @brief decodes the container back to rows
+		 *
+		 * @return vector<vector<int64_t>> the rows
+		 */
+		vector<vector<int64_t>> toRows() const;
+	};
+
+	/**
+	 * @brief record a message in the in-memory trace ring buffer (use TRACE macro instead)
+	 *
+	 * Keeps the latest TRACE_BUFFER_SIZE messages, thread-safe.
+	 *
+	 * @param level the trace level of the message (TRACE_ERROR ... TRACE_ACCESS)
+	 * @param message the message
+	 */
+	void traceMessage(const int level, const string &message);
+
+	/**
+	 * @brief record a formatted message in the in-memory trace ring buffer (use TRACE macro instead)
+	 *
+	 * @param level the trace level of the message (TRACE_ERROR ... TRACE_ACCESS)
+	 * @param message the message
+	 */
+	void traceMessage(const int level, const boost::format &message);
+
+	/**
+	 * @brief read the trace ring buffer
+	 *
+	 * @param output the vector to append the recorded messages to (oldest first)
+	 */
+	void getTrace(vector<string> &output);
 }
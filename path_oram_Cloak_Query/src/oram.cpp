@@ -22,7 +22,8 @@ namespace CloakQueryPathORAM
 		const shared_ptr<AbsPositionMapAdapter> map,
 		const shared_ptr<AbsStashAdapter> stash,
 		const bool initialize,
-		const number batchSize) :
+		const number batchSize,
+		const bool merkle) :
 		storage(storage),
 		map(map),
 		stash(stash),
@@ -32,14 +33,22 @@ namespace CloakQueryPathORAM
 		buckets((number)1 << logCapacity),
 		blocks(((number)1 << logCapacity) * Z),
 		batchSize(batchSize),
-		isInitializing(initialize)
+		isInitializing(initialize),
+		merkle(merkle),
+		macs(!merkle && !storage->isAuthenticated())
 	{
+		if (merkle && Z < 2)
+		{
+			throw Exception(boost::format("Merkle mode reserves a slot per bucket, Z must be at least 2 (provided %1%)") % Z);
+		}
+
 		//Generate a random key for HMAC
 		if (!isKeyGenerated)
 		{
 			key = generateKey();
 			isKeyGenerated = true;
 		}
+		macContext = make_unique<MacContext>(key);
 		
 		if (initialize)
 		{
@@ -54,11 +63,16 @@ namespace CloakQueryPathORAM
 			}
 			auto end = std::chrono::high_resolution_clock::now();
 			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-			std::cout << "PM population with data: " << duration.count() << " milliseconds" << std::endl;
+			TRACE(TRACE_INFO, boost::format("PM population with data: %1% milliseconds") % duration.count());
 			
 			// Compute and store MACs for all buckets
 			//computeAndStoreAllBucketMACs();
 
+			if (merkle)
+			{
+				buildMerkleTree();
+			}
+
 			// Initialization is complete and the verification of MAC should be done from here on
 			//isInitializing = false;
 		}
@@ -76,7 +90,7 @@ namespace CloakQueryPathORAM
 
 	void ORAM::get(const number block, bytes &response)
 	{
-		std::cout << "Getting data for blockID: " << block << std::endl;
+		TRACE(TRACE_ACCESS, boost::format("Getting data for blockID: %1%") % block);
 		bytes data;
 		access(true, block, data, response);
 		syncCache();
@@ -85,7 +99,7 @@ namespace CloakQueryPathORAM
 	void ORAM::put(const number block, const bytes &data)
 	{
 		//std::cout << "Put function call" << std::endl;
-		std::cout << "Putting data for block: " << block << ", Data size: " << data.size() << std::endl;
+		TRACE(TRACE_ACCESS, boost::format("Putting data for block: %1%, Data size: %2%") % block % data.size());
 		bytes response;
 		access(false, block, data, response);
 		syncCache();
@@ -124,7 +138,8 @@ namespace CloakQueryPathORAM
 	void ORAM::load(vector<block> &data)
 	{
 		const number maxLocation = 1 << height;
-		const auto bucketCount	 = (data.size() + Z - 1) / Z; // for rounding errors
+		const auto slots		 = merkle ? Z - 1 : Z;				// the last slot holds the children hashes in Merkle mode
+		const auto bucketCount	 = (data.size() + slots - 1) / slots; // for rounding errors
 		const auto step			 = maxLocation / (long double)bucketCount;
 
 		if (bucketCount > maxLocation)
@@ -156,12 +171,16 @@ namespace CloakQueryPathORAM
 			const auto [from, to] = leavesForLocation(location);
 			map->set(record.first, getRandomULong(to - from + 1) + from);
 
-			if (bucket.size() < Z)
+			if (bucket.size() < slots)
 			{
 				bucket.push_back(record);
 			}
-			if (bucket.size() == Z)
+			if (bucket.size() == slots)
 			{
+				if (merkle)
+				{
+					bucket.push_back({MERKLE_ID, bytes()});
+				}
 				writeRequests.push_back({location, bucket});
 				iteration++;
 				bucket.clear();
@@ -178,11 +197,16 @@ namespace CloakQueryPathORAM
 		}
 
 		storage->set(boost::make_iterator_range(writeRequests.begin(), writeRequests.end()));
+
+		if (merkle)
+		{
+			buildMerkleTree();
+		}
 	}
 
 	void ORAM::access(const bool read, const number block, const bytes &data, bytes &response)
 	{
-		std::cout << "Accessing and remapping block: " << block << std::endl;
+		TRACE(TRACE_ACCESS, boost::format("Accessing and remapping block: %1%") % block);
 		// step 1 from paper: remap block
 		const auto previousPosition = map->get(block);
 		//auto start = std::chrono::high_resolution_clock::now();
@@ -224,22 +248,7 @@ namespace CloakQueryPathORAM
 	void ORAM::putContainer(const number block, const vector<vector<int64_t>> &container)
 	{
 		//std::cout << "Putting container for block: " << block << std::endl;
-		bytes serializedData = serialize(container);
-
-		// Manage the scenario when the data is smaller than the block size
-		uint64_t dataSize = serializedData.size();
-
-		bytes macSerializedData = hmac(key, serializedData);
-		
-		//std::cout << std::endl << "Size of MAC:" << macSerializedData.size() << std::endl;
-		// Create a new variable with the size of the data
-		bytes dataWithSize(sizeof(dataSize));
-		memcpy(dataWithSize.data(), &dataSize, sizeof(dataSize));
-		// Append the serialized data to variable crafted above
-		dataWithSize.insert(dataWithSize.end(), serializedData.begin(), serializedData.end());
-		
-		// Return the data to the ORAM
-		put(block, dataWithSize);
+		put(block, encodeContainerBlock(container));
 
 		usedBlockIDs.insert(block); // Track this block as used
 	}
@@ -263,13 +272,36 @@ namespace CloakQueryPathORAM
 		pathRetrievalTime += purePathMs;
 
 		//std::cout << "Getting container for block: " << block << ", Data size: " << blockData.size() << std::endl;
+		return decodeContainer(blockData);
+	}
+
+	bytes ORAM::encodeContainerBlock(const vector<vector<int64_t>> &container) const
+	{
+		// packed columnar encoding, the header carries the number of rows and attributes
+		auto encoded = encodeContainer(container);
+		if (encoded.size() > dataSize)
+		{
+			throw Exception(boost::format("container of %1% rows needs %2% bytes, the block is %3% bytes") % container.size() % encoded.size() % dataSize);
+		}
+		// a full block, the stash normalizes the sizes of the blocks it holds
+		encoded.resize(dataSize, 0x00);
+		return encoded;
+	}
+
+	vector<vector<int64_t>> ORAM::decodeContainer(const bytes &blockData) const
+	{
 		// Check if the block is empty
 		if (blockData.empty())
 		{
-			std::cout << "Block data is empty." << std::endl;
+			TRACE(TRACE_WARNING, "Block data is empty.");
 			return vector<vector<int64_t>>(); // Return an empty vector if the block is empty
 		}
-		// Extract the size of the data
+		if (ContainerView::matches(blockData))
+		{
+			return ContainerView(blockData).toRows();
+		}
+
+		// legacy format: the size of the data, then row-major int64 values
 		uint64_t dataSize = 0;
 		memcpy(&dataSize, blockData.data(), sizeof(dataSize));
 
@@ -278,6 +310,134 @@ namespace CloakQueryPathORAM
 		return deserialize(serializedData);
 	}
 
+	ContainerView ORAM::getContainerView(const number block, bytes &storage)
+	{
+		storage.clear();
+		get(block, storage);
+		return ContainerView(storage);
+	}
+
+	number ORAM::putContainers(const number firstBlock, const vector<vector<int64_t>> &table)
+	{
+		if (table.empty())
+		{
+			return 0;
+		}
+
+		const number attributes = table[0].size();
+		for (auto &&row : table)
+		{
+			if (row.size() != attributes)
+			{
+				throw Exception(boost::format("all rows of a table must have %1% attributes (given %2%)") % attributes % row.size());
+			}
+		}
+
+		// the worst case of the encoding, so that every chunk fits
+		number rowsPerBlock = table.size();
+		if (attributes > 0)
+		{
+			if (encodedContainerSize(1, attributes) > dataSize)
+			{
+				throw Exception(boost::format("a row of %1% attributes does not fit in a block of %2% bytes") % attributes % dataSize);
+			}
+			rowsPerBlock = (dataSize - encodedContainerSize(0, attributes)) / (attributes * sizeof(int64_t));
+		}
+		const number blockCount = (table.size() + rowsPerBlock - 1) / rowsPerBlock;
+
+		vector<block> requests;
+		vector<bytes> response;
+		requests.reserve(min(batchSize, blockCount));
+		for (number i = 0; i < blockCount; i++)
+		{
+			const vector<vector<int64_t>> chunk(
+				table.begin() + i * rowsPerBlock,
+				table.begin() + min((i + 1) * rowsPerBlock, (number)table.size()));
+
+			requests.push_back({firstBlock + i, encodeContainerBlock(chunk)});
+
+			if (requests.size() == batchSize || i == blockCount - 1)
+			{
+				multiple(requests, response);
+				requests.clear();
+				response.clear();
+			}
+			usedBlockIDs.insert(firstBlock + i);
+		}
+
+		return blockCount;
+	}
+
+	vector<vector<int64_t>> ORAM::getContainers(const vector<number> &blocks)
+	{
+		vector<vector<int64_t>> table;
+		vector<block> requests;
+		vector<bytes> response;
+		for (number i = 0; i < blocks.size(); i++)
+		{
+			requests.push_back({blocks[i], bytes()});
+			if (requests.size() == batchSize || i == blocks.size() - 1)
+			{
+				timedMultiple(requests, response);
+				for (auto &&blockData : response)
+				{
+					auto rows = decodeContainer(blockData);
+					table.insert(table.end(), make_move_iterator(rows.begin()), make_move_iterator(rows.end()));
+				}
+				requests.clear();
+				response.clear();
+			}
+		}
+		return table;
+	}
+
+	void ORAM::scanContainers(const vector<number> &blocks, const function<void(const number block, const ContainerView &view)> &visitor)
+	{
+		vector<block> requests;
+		vector<bytes> response;
+		for (number i = 0; i < blocks.size(); i++)
+		{
+			requests.push_back({blocks[i], bytes()});
+			if (requests.size() == batchSize || i == blocks.size() - 1)
+			{
+				timedMultiple(requests, response);
+				for (number j = 0; j < response.size(); j++)
+				{
+					auto &blockData = response[j];
+					if (!ContainerView::matches(blockData))
+					{
+						// empty or legacy format: decoded as in getContainers, re-encoded for the view
+						auto rows = decodeContainer(blockData);
+						if (rows.empty())
+						{
+							continue;
+						}
+						blockData = encodeContainer(rows);
+					}
+					visitor(requests[j].first, ContainerView(blockData));
+				}
+				requests.clear();
+				response.clear();
+			}
+		}
+	}
+
+	void ORAM::timedMultiple(const vector<block> &requests, vector<bytes> &response)
+	{
+		// Measure only the path retrieval time excluding integrity checks and reshuffles
+		const auto wallStart = std::chrono::high_resolution_clock::now();
+		const long long integrityStart = totalIntegrityCheckTime;
+		const long long reshuffleStart  = totalReshuffleTime;
+
+		multiple(requests, response);
+
+		const auto wallEnd = std::chrono::high_resolution_clock::now();
+		const long long wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(wallEnd - wallStart).count();
+		long long purePathMs = wallMs - (totalIntegrityCheckTime - integrityStart) - (totalReshuffleTime - reshuffleStart);
+		if (purePathMs < 0) purePathMs = 0; // safety against timing jitter/rounding
+		pathRetrievalTime += purePathMs;
+	}
+
 	void ORAM::readPath(const number leaf, unordered_set<number> &path, const bool putInStash)
 	{
 		//std::cout << "Reading path for leaf: " << leaf << std::endl;
@@ -301,35 +461,14 @@ namespace CloakQueryPathORAM
 
 			for (auto &&[id, data] : blocks)
 			{
-				// skip "empty" buckets
-				if (id != ULONG_MAX)
+				// skip "empty" buckets and the Merkle slots
+				if (id != ULONG_MAX && id != MERKLE_ID)
 				{
 					stash->add(id, data);
 				}
 			}
 
-			// Verify the integrity of each bucket in the path
-			for (const auto &bucketId : path)
-			{
-				//std::cout << "Verifying bucket integrity for ID: " << bucketId << std::endl;
-				const auto &bucketData = cache[bucketId]; // Retrieve the bucket from the cach
-				
-				number level = 0;
-				number currentLeaf = leaf;
-				while (bucketForLevelLeaf(level, currentLeaf) != bucketId && level < height)
-				{
-					level++;
-				}
-				auto start = std::chrono::high_resolution_clock::now();
-				bool ok = verifyBucketMAC(level, leaf, bucketData);
-				auto end = std::chrono::high_resolution_clock::now();
-				totalIntegrityCheckTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-
-				if (!ok)
-				{
-					throw Exception("Bucket integrity check failed during readPath for bucket ID: " + std::to_string(bucketId));
-				}
-			}
+			// the buckets were verified once, when downloaded into the cache (getCache)
 		}
 	}
 
@@ -342,10 +481,13 @@ namespace CloakQueryPathORAM
 		vector<int> toDelete;				   // rember the records that will need to be deleted from stash
 		vector<pair<number, bucket>> requests; // storage SET requests (batching)
 
+		const auto slots = merkle ? Z - 1 : Z; // the last slot holds the children hashes in Merkle mode
+		bytes childDigest;					   // Merkle mode: the hash of the bucket written on the level below
+
 		// following the path from leaf to root (greedy)
 		for (int level = height - 1; level >= 0; level--)
 		{
-			vector<block> toInsert;		  // block to be insterted in the bucket (up to Z)
+			vector<block> toInsert;		  // block to be insterted in the bucket (up to slots)
 			vector<number> toDeleteLocal; // same blocks needs to be deleted from stash (these hold indices of elements in currentStash)
 
 			for (number i = 0; i < currentStash.size(); i++)
@@ -365,8 +507,8 @@ namespace CloakQueryPathORAM
 
 					toDeleteLocal.push_back(i);
 
-					// look up to Z
-					if (toInsert.size() == Z)
+					// look up to Z (or Z - 1 in Merkle mode)
+					if (toInsert.size() == slots)
 					{
 						break;
 					}
@@ -386,7 +528,7 @@ namespace CloakQueryPathORAM
 
 			// write the bucket
 			// Fill Z blocks with data or dummy blocks
-			for (number i = 0; i < Z; i++)
+			for (number i = 0; i < slots; i++)
 			{
 				// auto block = bucket * Z + i;
 				if (toInsert.size() != 0)
@@ -400,26 +542,59 @@ namespace CloakQueryPathORAM
 					bucketData[i] = {ULONG_MAX, getRandomBlock(dataSize)};
 				}
 			}
-			//if (!isInitializing) {
-				computeAndStoreBucketMAC(level, leaf, bucketData);	
-			//}
-			
 
-			// Verify the integrity of the bucket before writing it back
 			auto start = std::chrono::high_resolution_clock::now();
-			bool ok = verifyBucketMAC(level, leaf, bucketData);
+			if (merkle)
+			{
+				// the hash of the child on this path is new, the hash of the other child stays as read
+				bytes children(dataSize, 0x00);
+				if (level < (int)height - 1)
+				{
+					const auto child	= bucketForLevelLeaf(level + 1, leaf);
+					const auto previous = cache.find(bucketId);
+					if (previous == cache.end())
+					{
+						throw Exception(boost::format("bucket %1% must be read before it is written in Merkle mode") % bucketId);
+					}
+					const auto &hashes = (*previous).second[Z - 1].second;
+					copy(hashes.begin(), hashes.begin() + 2 * (HASHSIZE / 16), children.begin());
+					copy(childDigest.begin(), childDigest.end(), children.begin() + (child % 2) * (HASHSIZE / 16));
+				}
+				bucketData[Z - 1] = {MERKLE_ID, children};
+				childDigest		  = bucketDigest(bucketData);
+			}
 			auto end = std::chrono::high_resolution_clock::now();
 			totalIntegrityCheckTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-			if (!ok)
+			requests.push_back({bucketId, bucketData});
+		}
+
+		if (macs)
+		{
+			// MACs of all buckets of the path in one batch;
+			// a bucket is verified when it is downloaded next time, not right after the MAC is computed
+			auto start = std::chrono::high_resolution_clock::now();
+			vector<const bucket *> pathBuckets;
+			pathBuckets.reserve(requests.size());
+			for (auto &&request : requests)
 			{
-				throw Exception("Bucket integrity check failed during readPath for bucket ID: " + std::to_string(bucketId));
+				pathBuckets.push_back(&request.second);
 			}
-
-			requests.push_back({bucketId, bucketData});
+			vector<bytes> macs;
+			macContext->digests(pathBuckets, Z, macs);
+			for (auto i = 0uLL; i < requests.size(); i++)
+			{
+				macMap[requests[i].first] = move(macs[i]);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			totalIntegrityCheckTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 		}
 
 		setCache(requests);
+		if (merkle)
+		{
+			merkleRoot = childDigest;
+		}
 
 		// update the stash adapter, remove newly inserted blocks
 		for (auto &&removed : toDelete)
@@ -432,8 +607,13 @@ namespace CloakQueryPathORAM
 
 	void ORAM::computeAndStoreAllBucketMACs()
 	{
-		std::cout << "Computing and storing MACs for all buckets..." << std::endl;
-		std::cout << "Number of buckets: " << buckets << std::endl;
+		if (!macs)
+		{
+			// buckets are protected by the Merkle tree or by the authenticated storage
+			return;
+		}
+
+		TRACE(TRACE_INFO, boost::format("Computing and storing MACs for all %1% buckets") % buckets);
 
 		// Iterate through all the buckets in the ORAM
 		// for (number bucketID = 0; bucketID < buckets; ++bucketID)
@@ -456,7 +636,7 @@ namespace CloakQueryPathORAM
 		// 	// Update the bucket in the cache
 		// 	setCache({{bucketID, bucketBlocks}});
 		// }
-		std::cout << "Height of the ORAM: " << height << std::endl;
+		TRACE(TRACE_INFO, boost::format("Height of the ORAM: %1%") % height);
 		for (number level = 0; level <= height; ++level)
 		{
 			const number numBucketsAtLevel = 1 << level; // Number of buckets at the current level
@@ -519,6 +699,9 @@ namespace CloakQueryPathORAM
 
 		if (toGet.size() > 0)
 		{
+			// parents first, so that in Merkle mode a bucket is checked against its already trusted parent
+			sort(toGet.begin(), toGet.end());
+
 			// download those blocks
 			vector<block> downloaded;
 			storage->get(toGet, downloaded);
@@ -545,7 +728,8 @@ namespace CloakQueryPathORAM
 					}
 					// Verify the integrity of the bucket before writing it back
 					auto start = std::chrono::high_resolution_clock::now();
-					bool ok = verifyBucketMAC(level, leaf, bucket);
+					// with authenticated storage the bucket has already been verified while being decrypted
+					bool ok = merkle ? verifyBucketHash(bucketId, bucket) : (!macs || verifyBucketMAC(level, leaf, bucket));
 					auto end = std::chrono::high_resolution_clock::now();
 					totalIntegrityCheckTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
@@ -585,23 +769,14 @@ namespace CloakQueryPathORAM
 		//Dynamically calculate the bucket ID
 		const number bucketId = bucketForLevelLeaf(level, leaf);
 
-		bytes concatenatedData;
-		//std::cout << "Computing MAC for bucket..." << bucketId << std::endl;
-
-		// Compute the MAC for each block in the bucket
-		for (size_t i = 0; i < Z; i++)
-		{
-				concatenatedData.insert(concatenatedData.end(), bucketData[i].second.begin(), bucketData[i].second.end());
-		}
-
 		// Print the block ID in the bucket and the corresponding data size
 		// for (const auto &block : bucketData)
 		// {
 		// 	std::cout << "Block ID durin MAC computing: " << block.first << ", Data Size: " << block.second.size() << std::endl;
 		// }
 
-		// Compute MAC using the stored key 
-		bytes hash = hmac(key, concatenatedData);
+		// Compute MAC over the Z payloads using the keyed context
+		bytes hash = macContext->digest(bucketData, Z);
 		
 		macMap[bucketId] = hash; // Store the MAC in the map
 		// Print macMap
@@ -651,17 +826,13 @@ namespace CloakQueryPathORAM
 	
 	bytes ORAM::generateKey() const
 	{
-		std::cout << "Generating key..." << std::endl;
+		TRACE(TRACE_INFO, "Generating key...");
 		if (std::filesystem::exists("../key/key.bin"))
 		{
 			return loadKeyFromFile("../key/key.bin"); // Load the key from a file if it exists
 		}
 
-		bytes key(KEYSIZE, 0);
-		for (size_t i = 0; i < KEYSIZE; ++i)
-		{
-			key[i] = static_cast<uchar>(rand() % 256); // Generate a random byte
-		}
+		auto key = getRandomBlock(KEYSIZE); // CSPRNG in production builds, a seeded rand() would repeat the key
 		saveKeyToFile(key, "../key/key.bin"); // Save the key to a file
 		return key;
 	}
@@ -695,15 +866,8 @@ namespace CloakQueryPathORAM
 		// Print the bucket ID
 		//std::cout << "Verifying MAC for bucket ID: " << bucketId << std::endl;
 
-		// Concatenate the data from the other blocks in the bucket
-		bytes concatenatedData;
-		for (size_t i = 0; i < Z; i++)
-		{
-				// Concatenate the data from the blocks
-				concatenatedData.insert(concatenatedData.end(), bucketData[i].second.begin(), bucketData[i].second.end());
-		}
-		// Compute the MAC for the concatenated data using the stored key
-		bytes computedMAC = hmac(key, concatenatedData);
+		// Compute the MAC over the payloads of the blocks using the keyed context
+		bytes computedMAC = macContext->digest(bucketData, Z);
 		// std::cout << "Stored MAC: " << storedMAC.size() << std::endl;
 		// // Print Stored MAC
 		// for (const auto &byte : storedMAC)
@@ -719,7 +883,7 @@ namespace CloakQueryPathORAM
 		// }
 		// std::cout << std::endl;
 
-		if (computedMAC != computedMAC)
+		if (computedMAC != storedMAC)
 		{
 			throw Exception("Bucket integrity check failed: MAC mismatch");
 			return false; // Integrity check failed
@@ -727,6 +891,96 @@ namespace CloakQueryPathORAM
 		else return true; // Integrity check passed
 	}
 
+	bytes ORAM::bucketDigest(const bucket &bucketData) const
+	{
+		// every slot is ID and payload padded to dataSize (as it comes back from the storage)
+		const auto slotSize = sizeof(number) + dataSize;
+		bytes serialized(Z * slotSize, 0x00);
+		for (number i = 0; i < Z; i++)
+		{
+			memcpy(serialized.data() + i * slotSize, &bucketData[i].first, sizeof(number));
+			copy(bucketData[i].second.begin(), bucketData[i].second.begin() + min((number)bucketData[i].second.size(), dataSize), serialized.begin() + i * slotSize + sizeof(number));
+		}
+
+		bytes digest;
+		hash(serialized, digest);
+		return digest;
+	}
+
+	bool ORAM::verifyBucketHash(const number location, const bucket &bucketData) const
+	{
+		bytes expected;
+		if (location == 1)
+		{
+			if (merkleRoot.empty())
+			{
+				throw Exception("Merkle root is not set (see setMerkleRoot)");
+			}
+			expected = merkleRoot;
+		}
+		else
+		{
+			const auto parent = cache.find(location / 2);
+			if (parent == cache.end())
+			{
+				throw Exception(boost::format("parent of bucket %1% must be in the cache to verify it") % location);
+			}
+			const auto &hashes = (*parent).second[Z - 1].second;
+			const auto offset  = (location % 2) * (HASHSIZE / 16);
+			expected		   = bytes(hashes.begin() + offset, hashes.begin() + offset + HASHSIZE / 16);
+		}
+
+		if (bucketDigest(bucketData) != expected)
+		{
+			throw Exception(boost::format("Bucket integrity check failed: Merkle hash mismatch for bucket ID %1%") % location);
+		}
+		return true;
+	}
+
+	void ORAM::buildMerkleTree()
+	{
+		TRACE(TRACE_INFO, boost::format("Building Merkle tree over %1% buckets") % (buckets - 1));
+
+		// hashes of the level below, indexed by location minus the first location of that level
+		vector<bytes> below;
+		for (int level = height - 1; level >= 0; level--)
+		{
+			const number first = (number)1 << level;
+
+			vector<number> locations;
+			for (auto location = first; location < 2 * first; location++)
+			{
+				locations.push_back(location);
+			}
+
+			vector<block> blocks;
+			storage->get(locations, blocks);
+
+			vector<pair<const number, bucket>> requests;
+			vector<bytes> hashes;
+			for (number i = 0; i < locations.size(); i++)
+			{
+				bucket bucketData(blocks.begin() + i * Z, blocks.begin() + (i + 1) * Z);
+
+				bytes children(dataSize, 0x00);
+				if (level < (int)height - 1)
+				{
+					copy(below[2 * i].begin(), below[2 * i].end(), children.begin());
+					copy(below[2 * i + 1].begin(), below[2 * i + 1].end(), children.begin() + HASHSIZE / 16);
+				}
+				bucketData[Z - 1] = {MERKLE_ID, children};
+
+				hashes.push_back(bucketDigest(bucketData));
+				requests.push_back({locations[i], move(bucketData)});
+			}
+
+			storage->set(boost::make_iterator_range(requests.begin(), requests.end()));
+			below = move(hashes);
+		}
+
+		merkleRoot = below[0];
+	}
+
 	void ORAM::saveMacMap(const std::string &filename) const
 	{
 		std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
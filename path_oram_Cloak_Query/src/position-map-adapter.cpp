@@ -1,4 +1,5 @@
 #include "position-map-adapter.hpp"
+#include "utility.hpp"
 
 #include <boost/format.hpp>
 #include <cstring>
@@ -54,7 +55,7 @@ namespace CloakQueryPathORAM
 
 	void InMemoryPositionMapAdapter::loadFromFile(const string filename)
 	{
-		std::cout<< "Position map initialized from file: " << filename << std::endl;
+		TRACE(TRACE_INFO, boost::format("Position map initialized from file: %1%") % filename);
 		fstream file;
 
 		file.open(filename, fstream::in | fstream::binary);
@@ -45,7 +45,7 @@ namespace CloakQueryPathORAM
 		checkOverflow(block);
 		// Skip or throw on invalid block IDs
 		if (block == ULONG_MAX || block > 1e12) {
-			std::cerr << "[Stash add] Skipping suspicious block ID: " << block << std::endl;
+			std::cerr << "[Stash add] Skipping suspicious block ID: " << block << std::endl; // rare, not traced: signals a corrupted stash
 			return; // Or throw Exception if you want to be strict
 		}
 		// Pad or truncate to match the defined block size
@@ -55,13 +55,11 @@ namespace CloakQueryPathORAM
 		} else {
 			blockSize = data.size(); // Use first block's size as reference
 		}
-		bytes adjustedData = data;
-		if (data.size() < blockSize) {
-			adjustedData.resize(blockSize, 0); // Pad with zeros
-		} else if (data.size() > blockSize) {
-			adjustedData.resize(blockSize); // Truncate
+		// Copy once into the map, then pad with zeros or truncate in place
+		const auto [entry, inserted] = stash.try_emplace(block, data);
+		if (inserted) {
+			entry->second.resize(blockSize, 0);
 		}
-		stash.insert({block, adjustedData});
 	}
 
 	void InMemoryStashAdapter::update(const number block, const bytes &data)
@@ -73,13 +71,10 @@ namespace CloakQueryPathORAM
 		} else {
 			blockSize = data.size();
 		}
-		bytes adjustedData = data;
-		if (data.size() < blockSize) {
-			adjustedData.resize(blockSize, 0);
-		} else if (data.size() > blockSize) {
-			adjustedData.resize(blockSize);
-		}
-		stash[block] = adjustedData;
+		// Reuse the existing buffer if the block is already there
+		auto &stored = stash[block];
+		stored.assign(data.begin(), data.end());
+		stored.resize(blockSize, 0);
 	}
 
 	void InMemoryStashAdapter::get(const number block, bytes &response) const
@@ -194,8 +189,7 @@ namespace CloakQueryPathORAM
 				copy(buffer.begin() + offset, buffer.begin() + offset + sizeof(number), numberBuffer);
 				number block = ((number *)numberBuffer)[0];
 
-				// Print/log block ID for debugging
-				std::cout << "[Stash load] Block ID: " << block << std::endl;
+				TRACE(TRACE_ACCESS, boost::format("[Stash load] Block ID: %1%") % block);
 
 				// Optionally, skip obviously invalid block IDs (e.g., > 1e12 or 0xFFFFFFFFFFFF)
 				if (block == ULONG_MAX || block > 1e12) {
@@ -83,20 +83,40 @@ namespace CloakQueryPathORAM
 		}
 
 		response.reserve(locations.size() * Z);
-		for (auto &&raw : raws)
+		for (auto r = 0uLL; r < raws.size(); r++)
 		{
+			const auto &raw = raws[r];
+
 			// decompose to ID and cipher
 
 			bytes decrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				raw.begin(),
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.end(),
-				decrypted,
-				DECRYPT);
+			if (gcm)
+			{
+				const number buffer[1] = {locations[r]};
+				const bytes associated((uchar *)buffer, (uchar *)buffer + sizeof(number));
+				bytes tag(raw.begin() + GCM_IV_SIZE, raw.begin() + GCM_IV_SIZE + AES_BLOCK_SIZE);
+				sealer->encrypt(
+					raw.begin(),
+					raw.begin() + GCM_IV_SIZE,
+					raw.begin() + GCM_IV_SIZE + AES_BLOCK_SIZE,
+					raw.end(),
+					associated,
+					tag,
+					decrypted,
+					DECRYPT);
+			}
+			else
+			{
+				encrypt(
+					key.begin(),
+					key.end(),
+					raw.begin(),
+					raw.begin() + AES_BLOCK_SIZE,
+					raw.begin() + AES_BLOCK_SIZE,
+					raw.end(),
+					decrypted,
+					DECRYPT);
+			}
 
 			const auto length = decrypted.size() / Z;
 
@@ -150,17 +170,40 @@ namespace CloakQueryPathORAM
 				toEncrypt.insert(toEncrypt.end(), block.second.begin(), block.second.end());
 			}
 
-			auto iv = getRandomBlock(AES_BLOCK_SIZE);
-			bytes encrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				iv.begin(),
-				iv.end(),
-				toEncrypt.begin(),
-				toEncrypt.end(),
-				iv, // append result to IV
-				ENCRYPT);
+			auto iv = getRandomBlock(gcm ? GCM_IV_SIZE : AES_BLOCK_SIZE);
+			if (gcm)
+			{
+				const number buffer[1] = {location};
+				const bytes associated((uchar *)buffer, (uchar *)buffer + sizeof(number));
+				bytes tag;
+				bytes encrypted;
+				encrypted.reserve(blockSize);
+				encrypted.insert(encrypted.end(), iv.begin(), iv.end());
+				encrypted.resize(GCM_IV_SIZE + AES_BLOCK_SIZE); // room for the tag
+				sealer->encrypt(
+					iv.begin(),
+					iv.end(),
+					toEncrypt.begin(),
+					toEncrypt.end(),
+					associated,
+					tag,
+					encrypted, // append result to IV and tag
+					ENCRYPT);
+				copy(tag.begin(), tag.end(), encrypted.begin() + GCM_IV_SIZE);
+				iv = move(encrypted);
+			}
+			else
+			{
+				encrypt(
+					key.begin(),
+					key.end(),
+					iv.begin(),
+					iv.end(),
+					toEncrypt.begin(),
+					toEncrypt.end(),
+					iv, // append result to IV
+					ENCRYPT);
+			}
 
 			writes.push_back({location, iv});
 		}
@@ -251,11 +294,12 @@ namespace CloakQueryPathORAM
 		key(key.size() == KEYSIZE ? key : getRandomBlock(KEYSIZE)),
 		Z(Z),
 		batchLimit(batchLimit),
+		gcm(__blockCipherMode == GCM),
 		capacity(capacity),
-		blockSize((userBlockSize + AES_BLOCK_SIZE) * Z + AES_BLOCK_SIZE), // IV + Z * (ID + PAYLOAD)
+		blockSize((userBlockSize + AES_BLOCK_SIZE) * Z + (__blockCipherMode == GCM ? GCM_IV_SIZE + AES_BLOCK_SIZE : AES_BLOCK_SIZE)), // IV + (TAG) + Z * (ID + PAYLOAD)
 		userBlockSize(userBlockSize)
 	{
-		std::cout << "Storage has been initialized" << std::endl;
+		TRACE(TRACE_INFO, "Storage has been initialized");
 		if (userBlockSize < 2 * AES_BLOCK_SIZE)
 		{
 			throw Exception(boost::format("block size %1% is too small, need at least %2%") % userBlockSize % (2 * AES_BLOCK_SIZE));
@@ -270,6 +314,16 @@ namespace CloakQueryPathORAM
 		{
 			throw Exception(boost::format("Z must be greater than zero (provided %1%)") % Z);
 		}
+
+		if (gcm)
+		{
+			sealer = make_unique<GcmContext>(this->key);
+		}
+	}
+
+	bool AbsStorageAdapter::isAuthenticated() const
+	{
+		return gcm;
 	}
 
 	void AbsStorageAdapter::fillWithZeroes()
@@ -286,9 +340,7 @@ namespace CloakQueryPathORAM
 			}
 			requests.push_back({i, bucketData});
 		}
-		std::cout << "Total requests: " << requests.size() << std::endl;
-		std::cout << "Total capacity: " << capacity << std::endl;
-		std::cout << "Total block size: " << blockSize << std::endl;
+		TRACE(TRACE_INFO, boost::format("Filling storage: %1% requests, capacity %2%, block size %3%") % requests.size() % capacity % blockSize);
 		set(boost::make_iterator_range(requests.begin(), requests.end()));
 	}
 
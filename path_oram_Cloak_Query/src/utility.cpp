@@ -1,13 +1,19 @@
 #include "utility.hpp"
 
+#include <algorithm>
+#include <array>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/format.hpp>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
 #include <openssl/aes.h>
+#include <openssl/core_names.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
 #include <openssl/modes.h>
+#include <openssl/params.h>
 #include <openssl/rand.h>
 #include <random>
 #include <sstream>
@@ -164,6 +170,9 @@ namespace CloakQueryPathORAM
 					(block128_f)AES_encrypt);
 				break;
 
+			case GCM:
+				throw Exception("GCM needs a tag, use encryptAuthenticated");
+
 			default:
 				throw Exception(boost::format("Block cipher mode not implemented: %1%") % __blockCipherMode);
 		}
@@ -171,6 +180,119 @@ namespace CloakQueryPathORAM
 		output.insert(output.end(), outputMaterial, outputMaterial + size);
 	}
 
+	void encryptAuthenticated(
+		const bytes::const_iterator keyFirst,
+		const bytes::const_iterator keyLast,
+		const bytes::const_iterator ivFirst,
+		const bytes::const_iterator ivLast,
+		const bytes::const_iterator inputFirst,
+		const bytes::const_iterator inputLast,
+		const bytes &associated,
+		bytes &tag,
+		bytes &output,
+		const EncryptionMode mode)
+	{
+		GcmContext(bytes(keyFirst, keyLast)).encrypt(ivFirst, ivLast, inputFirst, inputLast, associated, tag, output, mode);
+	}
+
+	GcmContext::GcmContext(const bytes &key)
+	{
+#if INPUT_CHECKS
+		if (key.size() != KEYSIZE)
+		{
+			throw Exception(boost::format("key of size %1% bytes provided, need %2% bytes") % key.size() % KEYSIZE);
+		}
+#endif
+
+		try
+		{
+			HANDLE_ERROR((encryption = EVP_CIPHER_CTX_new()) != nullptr);
+			HANDLE_ERROR(EVP_EncryptInit_ex(encryption, EVP_aes_256_gcm(), nullptr, nullptr, nullptr));
+			HANDLE_ERROR(EVP_CIPHER_CTX_ctrl(encryption, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_SIZE, nullptr));
+			HANDLE_ERROR(EVP_EncryptInit_ex(encryption, nullptr, nullptr, key.data(), nullptr));
+
+			HANDLE_ERROR((decryption = EVP_CIPHER_CTX_new()) != nullptr);
+			HANDLE_ERROR(EVP_DecryptInit_ex(decryption, EVP_aes_256_gcm(), nullptr, nullptr, nullptr));
+			HANDLE_ERROR(EVP_CIPHER_CTX_ctrl(decryption, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_SIZE, nullptr));
+			HANDLE_ERROR(EVP_DecryptInit_ex(decryption, nullptr, nullptr, key.data(), nullptr));
+		}
+		catch (...)
+		{
+			EVP_CIPHER_CTX_free(decryption);
+			EVP_CIPHER_CTX_free(encryption);
+			throw;
+		}
+	}
+
+	GcmContext::~GcmContext()
+	{
+		EVP_CIPHER_CTX_free(decryption);
+		EVP_CIPHER_CTX_free(encryption);
+	}
+
+	void GcmContext::encrypt(
+		const bytes::const_iterator ivFirst,
+		const bytes::const_iterator ivLast,
+		const bytes::const_iterator inputFirst,
+		const bytes::const_iterator inputLast,
+		const bytes &associated,
+		bytes &tag,
+		bytes &output,
+		const EncryptionMode mode)
+	{
+		const auto size = distance(inputFirst, inputLast);
+
+#if INPUT_CHECKS
+		if (size == 0)
+		{
+			throw Exception("input must not be empty");
+		}
+
+		if (distance(ivFirst, ivLast) != GCM_IV_SIZE)
+		{
+			throw Exception(boost::format("IV of size %1% bytes provided, need %2% bytes") % distance(ivFirst, ivLast) % GCM_IV_SIZE);
+		}
+
+		if (mode == DECRYPT && tag.size() != AES_BLOCK_SIZE)
+		{
+			throw Exception(boost::format("tag of size %1% bytes provided, need %2% bytes") % tag.size() % AES_BLOCK_SIZE);
+		}
+#endif
+
+		const auto context		= mode == ENCRYPT ? encryption : decryption;
+		const auto cipherInit	= mode == ENCRYPT ? EVP_EncryptInit_ex : EVP_DecryptInit_ex;
+		const auto cipherUpdate = mode == ENCRYPT ? EVP_EncryptUpdate : EVP_DecryptUpdate;
+
+		// only the IV is set, the expanded key is kept
+		HANDLE_ERROR(cipherInit(context, nullptr, nullptr, nullptr, &(*ivFirst)));
+
+		const auto outputOffset = output.size();
+		output.resize(outputOffset + size);
+
+		int length;
+		if (associated.size() > 0)
+		{
+			HANDLE_ERROR(cipherUpdate(context, nullptr, &length, associated.data(), associated.size()));
+		}
+		HANDLE_ERROR(cipherUpdate(context, output.data() + outputOffset, &length, &(*inputFirst), size));
+
+		if (mode == ENCRYPT)
+		{
+			HANDLE_ERROR(EVP_EncryptFinal_ex(context, output.data() + outputOffset + length, &length));
+			tag.resize(AES_BLOCK_SIZE);
+			HANDLE_ERROR(EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, AES_BLOCK_SIZE, tag.data()));
+		}
+		else
+		{
+			HANDLE_ERROR(EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, AES_BLOCK_SIZE, tag.data()));
+			if (EVP_DecryptFinal_ex(context, output.data() + outputOffset + length, &length) <= 0)
+			{
+				output.resize(outputOffset);
+				throw Exception("authentication failed: tag does not match the ciphertext");
+			}
+		}
+	}
+
 	bytes fromText(const string text, const number BLOCK_SIZE)
 	{
 		stringstream padded;
@@ -261,23 +383,302 @@ namespace CloakQueryPathORAM
 	{
 		// https: //wiki.openssl.org/index.php/HMAC
 
-		uchar message[input.size()];
-		copy(input.begin(), input.end(), message);
-
-		uchar *digest = (unsigned char *)OPENSSL_malloc(EVP_MAX_MD_SIZE);
+		uchar digest[EVP_MAX_MD_SIZE];
 		unsigned int digestLength;
 
-		HMAC_CTX *context;
-		HANDLE_ERROR((context = HMAC_CTX_new()) != nullptr);
-		HANDLE_ERROR(HMAC_Init_ex(context, key.data(), key.size(), HASH_ALGORITHM(), nullptr));
-		HANDLE_ERROR(HMAC_Update(context, message, input.size()));
-		HANDLE_ERROR(HMAC_Final(context, digest, &digestLength));
+		HANDLE_ERROR(HMAC(HASH_ALGORITHM(), key.data(), key.size(), input.data(), input.size(), digest, &digestLength) != nullptr);
 
-		bytes output(digest, digest + digestLength);
+		return bytes(digest, digest + digestLength);
+	}
 
-		HMAC_CTX_free(context);
-		free(digest);
+	MacContext::MacContext(const bytes &key)
+	{
+		// same hash as hmac(...)
+		string digestName = EVP_MD_get0_name(HASH_ALGORITHM());
+		OSSL_PARAM parameters[] = {
+			OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digestName.data(), 0),
+			OSSL_PARAM_construct_end()};
+
+		try
+		{
+			HANDLE_ERROR((mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr)) != nullptr);
+			HANDLE_ERROR((keyed = EVP_MAC_CTX_new(mac)) != nullptr);
+			HANDLE_ERROR(EVP_MAC_init(keyed, key.data(), key.size(), parameters));
+		}
+		catch (...)
+		{
+			EVP_MAC_CTX_free(keyed);
+			EVP_MAC_free(mac);
+			throw;
+		}
+	}
+
+	MacContext::~MacContext()
+	{
+		EVP_MAC_CTX_free(keyed);
+		EVP_MAC_free(mac);
+	}
+
+	bytes MacContext::digest(const bucket &data, const number count)
+	{
+		uchar digest[EVP_MAX_MD_SIZE];
+		size_t digestLength;
+
+		// the duplicate carries the keyed state, the key is not processed again
+		auto working = EVP_MAC_CTX_dup(keyed);
+		HANDLE_ERROR(working != nullptr);
+		try
+		{
+			for (number i = 0; i < count; i++)
+			{
+				HANDLE_ERROR(EVP_MAC_update(working, data[i].second.data(), data[i].second.size()));
+			}
+			HANDLE_ERROR(EVP_MAC_final(working, digest, &digestLength, sizeof(digest)));
+		}
+		catch (...)
+		{
+			EVP_MAC_CTX_free(working);
+			throw;
+		}
+		EVP_MAC_CTX_free(working);
+
+		return bytes(digest, digest + digestLength);
+	}
+
+	void MacContext::digests(const vector<const bucket *> &data, const number count, vector<bytes> &output)
+	{
+		output.reserve(output.size() + data.size());
+		for (auto &&bucketData : data)
+		{
+			output.push_back(digest(*bucketData, count));
+		}
+	}
+
+	namespace
+	{
+		const uint32_t CONTAINER_MAGIC = 0x31435143; // "CQC1"
 
-		return output;
+		// magic, rows, attributes, reserved
+		const number CONTAINER_HEADER = 4 * sizeof(uint32_t);
+
+		// base, width, padding
+		const number CONTAINER_DESCRIPTOR = 2 * sizeof(int64_t);
+
+		number alignColumn(const number size)
+		{
+			return (size + sizeof(int64_t) - 1) / sizeof(int64_t) * sizeof(int64_t);
+		}
+	}
+
+	bytes encodeContainer(const vector<vector<int64_t>> &container)
+	{
+		const number rows		= container.size();
+		const number attributes = rows > 0 ? container[0].size() : 0;
+
+		for (auto &&row : container)
+		{
+			if (row.size() != attributes)
+			{
+				throw Exception(boost::format("all rows of a container must have %1% attributes (given %2%)") % attributes % row.size());
+			}
+		}
+
+		// choose base and width for every column
+		vector<int64_t> bases(attributes, 0);
+		vector<uchar> widths(attributes, sizeof(int64_t));
+		number size = CONTAINER_HEADER + attributes * CONTAINER_DESCRIPTOR;
+		for (number a = 0; a < attributes; a++)
+		{
+			if (rows > 0)
+			{
+				auto [min, max] = minmax_element(container.begin(), container.end(), [a](const vector<int64_t> &left, const vector<int64_t> &right) { return left[a] < right[a]; });
+				const uint64_t range = (uint64_t)(*max)[a] - (uint64_t)(*min)[a];
+				for (uchar width = 1; width < sizeof(int64_t); width *= 2)
+				{
+					if (range >> (8 * width) == 0)
+					{
+						widths[a] = width;
+						bases[a]  = (*min)[a];
+						break;
+					}
+				}
+			}
+			size += alignColumn(rows * widths[a]);
+		}
+
+		bytes encoded(size, 0x00);
+		uchar *pointer = encoded.data();
+
+		const uint32_t header[4] = {CONTAINER_MAGIC, (uint32_t)rows, (uint32_t)attributes, 0};
+		memcpy(pointer, header, CONTAINER_HEADER);
+		pointer += CONTAINER_HEADER;
+
+		for (number a = 0; a < attributes; a++)
+		{
+			memcpy(pointer, &bases[a], sizeof(int64_t));
+			pointer[sizeof(int64_t)] = widths[a];
+			pointer += CONTAINER_DESCRIPTOR;
+		}
+
+		for (number a = 0; a < attributes; a++)
+		{
+			for (number r = 0; r < rows; r++)
+			{
+				// little-endian, the low bytes of the offset from the base
+				const uint64_t value = (uint64_t)container[r][a] - (uint64_t)bases[a];
+				memcpy(pointer + r * widths[a], &value, widths[a]);
+			}
+			pointer += alignColumn(rows * widths[a]);
+		}
+
+		return encoded;
+	}
+
+	number encodedContainerSize(const number rows, const number attributes)
+	{
+		return CONTAINER_HEADER + attributes * (CONTAINER_DESCRIPTOR + rows * sizeof(int64_t));
+	}
+
+	bool ContainerView::matches(const bytes &encoded)
+	{
+		if (encoded.size() < CONTAINER_HEADER)
+		{
+			return false;
+		}
+
+		uint32_t magic;
+		memcpy(&magic, encoded.data(), sizeof(uint32_t));
+		return magic == CONTAINER_MAGIC;
+	}
+
+	ContainerView::ContainerView(const bytes &encoded) :
+		data(encoded.data())
+	{
+		if (!matches(encoded))
+		{
+			throw Exception("bytes are not an encoded container");
+		}
+
+		uint32_t header[4];
+		memcpy(header, data, CONTAINER_HEADER);
+		rowCount	   = header[1];
+		attributeCount = header[2];
+
+		number offset = CONTAINER_HEADER + attributeCount * CONTAINER_DESCRIPTOR;
+		if (encoded.size() < offset)
+		{
+			throw Exception(boost::format("encoded container of %1% attributes is truncated (%2% bytes)") % attributeCount % encoded.size());
+		}
+
+		bases.resize(attributeCount);
+		widths.resize(attributeCount);
+		offsets.resize(attributeCount);
+		for (number a = 0; a < attributeCount; a++)
+		{
+			const auto descriptor = data + CONTAINER_HEADER + a * CONTAINER_DESCRIPTOR;
+			memcpy(&bases[a], descriptor, sizeof(int64_t));
+			widths[a] = descriptor[sizeof(int64_t)];
+			if (widths[a] != 1 && widths[a] != 2 && widths[a] != 4 && widths[a] != 8)
+			{
+				throw Exception(boost::format("invalid width %1% of column %2%") % (number)widths[a] % a);
+			}
+
+			offsets[a] = offset;
+			offset += alignColumn(rowCount * widths[a]);
+		}
+
+		if (encoded.size() < offset)
+		{
+			throw Exception(boost::format("encoded container needs %1% bytes (given %2%)") % offset % encoded.size());
+		}
+	}
+
+	int64_t ContainerView::at(const number row, const number attribute) const
+	{
+#if INPUT_CHECKS
+		if (row >= rowCount || attribute >= attributeCount)
+		{
+			throw Exception(boost::format("(%1%, %2%) is out of bound (%3% x %4%)") % row % attribute % rowCount % attributeCount);
+		}
+#endif
+
+		uint64_t value = 0;
+		memcpy(&value, data + offsets[attribute] + row * widths[attribute], widths[attribute]);
+		return (int64_t)((uint64_t)bases[attribute] + value);
+	}
+
+	void ContainerView::column(const number attribute, int64_t *output) const
+	{
+#if INPUT_CHECKS
+		if (attribute >= attributeCount)
+		{
+			throw Exception(boost::format("attribute %1% is out of bound (%2%)") % attribute % attributeCount);
+		}
+#endif
+
+		const auto width  = widths[attribute];
+		const auto source = data + offsets[attribute];
+		switch (width)
+		{
+			case sizeof(int64_t):
+				memcpy(output, source, rowCount * sizeof(int64_t));
+				break;
+			default:
+				for (number r = 0; r < rowCount; r++)
+				{
+					uint64_t value = 0;
+					memcpy(&value, source + r * width, width);
+					output[r] = (int64_t)((uint64_t)bases[attribute] + value);
+				}
+				break;
+		}
+	}
+
+	vector<vector<int64_t>> ContainerView::toRows() const
+	{
+		vector<vector<int64_t>> rows(rowCount, vector<int64_t>(attributeCount));
+		vector<int64_t> values(rowCount);
+		for (number a = 0; a < attributeCount; a++)
+		{
+			column(a, values.data());
+			for (number r = 0; r < rowCount; r++)
+			{
+				rows[r][a] = values[r];
+			}
+		}
+		return rows;
+	}
+
+	namespace
+	{
+		mutex traceLock;
+		array<string, TRACE_BUFFER_SIZE> traceBuffer;
+		number traceNext = 0; // total messages recorded, traceNext % TRACE_BUFFER_SIZE is the slot to write next
+	}
+
+	void traceMessage(const int level, const string &message)
+	{
+		static const char *names[] = {"NONE", "ERROR", "WARNING", "INFO", "ACCESS"};
+
+		const auto entry = boost::str(boost::format("[%1%] %2%") % names[level] % message);
+
+		lock_guard<mutex> guard(traceLock);
+		traceBuffer[traceNext % TRACE_BUFFER_SIZE] = entry;
+		traceNext++;
+	}
+
+	void traceMessage(const int level, const boost::format &message)
+	{
+		traceMessage(level, boost::str(message));
+	}
+
+	void getTrace(vector<string> &output)
+	{
+		lock_guard<mutex> guard(traceLock);
+		const auto first = traceNext > TRACE_BUFFER_SIZE ? traceNext - TRACE_BUFFER_SIZE : 0;
+		for (auto i = first; i < traceNext; i++)
+		{
+			output.push_back(traceBuffer[i % TRACE_BUFFER_SIZE]);
+		}
 	}
 }
@@ -412,6 +412,215 @@ namespace CloakQueryPathORAM
 		EXPECT_EQ(0, *min_element(puts.begin(), puts.end()));
 	}
 
+	TEST_F(ORAMTest, MerklePutGetMany)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), true, BATCH_SIZE, true);
+		EXPECT_EQ(HASHSIZE / 16, oram->getMerkleRoot().size());
+
+		const auto count = CAPACITY * (Z - 1) / 2;
+		for (number id = 0; id < count; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		vector<block> batch;
+		for (number id = 0; id < count; id++)
+		{
+			batch.push_back({id, bytes()});
+			if (batch.size() == BATCH_SIZE || id == count - 1)
+			{
+				vector<bytes> response;
+				oram->multiple(batch, response);
+				for (number i = 0; i < batch.size(); i++)
+				{
+					EXPECT_EQ(to_string(batch[i].first), toText(response[i], BLOCK_SIZE));
+				}
+				batch.clear();
+			}
+		}
+	}
+
+	TEST_F(ORAMTest, MerkleBulkLoad)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), true, BATCH_SIZE, true);
+
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY * (Z - 1) / 2 + 1; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+		}
+		oram->load(batch);
+
+		for (number id = 0; id < CAPACITY * (Z - 1) / 2 + 1; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, MerkleTamper)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), true, BATCH_SIZE, true);
+		oram->put(0, fromText("hello", BLOCK_SIZE));
+
+		// replace the buckets of the second level (every path goes through one of the two) with well-formed ones
+		for (auto &&location : {2uLL, 3uLL})
+		{
+			bucket tampered;
+			storage->get(location, tampered);
+			tampered[0] = {ULONG_MAX, getRandomBlock(BLOCK_SIZE)};
+			storage->set(location, tampered);
+		}
+
+		bytes returned;
+		ASSERT_ANY_THROW(oram->get(0, returned));
+	}
+
+	TEST_F(ORAMTest, MerkleNoRoot)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+		auto oram	 = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), true, BATCH_SIZE, true);
+		const auto root = oram->getMerkleRoot();
+
+		// the same storage without the root cannot be trusted
+		auto reopened = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), false, BATCH_SIZE, true);
+		bytes returned;
+		ASSERT_ANY_THROW(reopened->get(0, returned));
+
+		reopened = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, make_shared<InMemoryStashAdapter>(4 * LOG_CAPACITY * Z), false, BATCH_SIZE, true);
+		reopened->setMerkleRoot(root);
+		ASSERT_NO_THROW(reopened->get(0, returned));
+	}
+
+	TEST_F(ORAMTest, AuthenticatedStoragePutGetMany)
+	{
+		__blockCipherMode = GCM;
+		auto storage	  = make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z);
+		__blockCipherMode = CBC;
+		auto oram		  = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), true, BATCH_SIZE);
+
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		for (number id = 0; id < CAPACITY * Z / 2; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		// no separate MACs are kept
+		EXPECT_TRUE(oram->macMap.empty());
+	}
+
+	TEST_F(ORAMTest, PutGetContainer)
+	{
+		const auto blockSize = 512uLL;
+		auto oram			 = make_unique<ORAM>(LOG_CAPACITY, blockSize, Z, make_shared<InMemoryStorageAdapter>(CAPACITY + Z, blockSize, bytes(), Z), make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), true, BATCH_SIZE);
+
+		// keys and dates take 2 bytes per value, so more rows fit than in the row-major format (128 bytes per 16 values)
+		vector<vector<int64_t>> container;
+		for (int64_t r = 0; r < 100; r++)
+		{
+			container.push_back({r, 20240101 + r});
+		}
+		oram->putContainer(3, container);
+		EXPECT_EQ(container, oram->getContainer(3));
+
+		bytes storage;
+		auto view = oram->getContainerView(3, storage);
+		EXPECT_EQ(100uLL, view.rows());
+		EXPECT_EQ(20240101 + 99, view.at(99, 1));
+
+		// legacy format: the size, then row-major values
+		const vector<vector<int64_t>> legacy(2, vector<int64_t>(16, -5));
+		auto serialized		= serialize(legacy);
+		const uint64_t size = serialized.size();
+		bytes block((uchar *)&size, (uchar *)&size + sizeof(size));
+		block.insert(block.end(), serialized.begin(), serialized.end());
+		block.resize(blockSize, 0x00);
+		oram->put(4, block);
+		EXPECT_EQ(legacy, oram->getContainer(4));
+
+		// random shares do not compress
+		vector<vector<int64_t>> shares;
+		for (auto r = 0; r < 100; r++)
+		{
+			shares.push_back({(int64_t)getRandomULong(ULONG_MAX), 1});
+		}
+		ASSERT_ANY_THROW(oram->putContainer(5, shares));
+	}
+
+	TEST_F(ORAMTest, PutGetContainers)
+	{
+		const auto blockSize = 512uLL;
+		auto oram			 = make_unique<ORAM>(LOG_CAPACITY, blockSize, Z, make_shared<InMemoryStorageAdapter>(CAPACITY + Z, blockSize, bytes(), Z), make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + BATCH_SIZE), true, BATCH_SIZE);
+
+		// 13 rows of 4 uncompressed attributes per block, so 16 blocks in 2 batches
+		vector<vector<int64_t>> table;
+		for (auto r = 0; r < 200; r++)
+		{
+			table.push_back({r, (int64_t)getRandomULong(ULONG_MAX), (int64_t)getRandomULong(ULONG_MAX), -r});
+		}
+		const auto blockCount = oram->putContainers(5, table);
+		ASSERT_EQ(16uLL, blockCount);
+
+		vector<number> blocks;
+		for (number i = 0; i < blockCount; i++)
+		{
+			blocks.push_back(5 + i);
+		}
+		EXPECT_EQ(blocks, oram->getUsedBlockIDs());
+		EXPECT_EQ(table, oram->getContainers(blocks));
+
+		// the same rows one block at a time
+		EXPECT_EQ(vector<int64_t>({13, table[13][1], table[13][2], -13}), oram->getContainer(6)[0]);
+
+		number rows = 0;
+		vector<number> visited;
+		oram->scanContainers(blocks, [&](const number block, const ContainerView &view) {
+			visited.push_back(block);
+			for (number r = 0; r < view.rows(); r++)
+			{
+				EXPECT_EQ((int64_t)(rows + r), view.at(r, 0));
+			}
+			rows += view.rows();
+		});
+		EXPECT_EQ(blocks, visited);
+		EXPECT_EQ(table.size(), rows);
+
+		// a legacy block is decoded and a block that was never written is skipped, as in getContainers
+		const vector<vector<int64_t>> legacy(2, vector<int64_t>(16, -5)); // the legacy format has 16 attributes
+		auto serialized		= serialize(legacy);
+		const uint64_t size = serialized.size();
+		bytes block((uchar *)&size, (uchar *)&size + sizeof(size));
+		block.insert(block.end(), serialized.begin(), serialized.end());
+		block.resize(blockSize, 0x00);
+		oram->put(50, block);
+
+		const vector<number> mixed = {5, 50, 60, 6};
+		vector<vector<int64_t>> scanned;
+		visited.clear();
+		oram->scanContainers(mixed, [&](const number block, const ContainerView &view) {
+			visited.push_back(block);
+			auto rows = view.toRows();
+			scanned.insert(scanned.end(), rows.begin(), rows.end());
+		});
+		EXPECT_EQ(vector<number>({5, 50, 6}), visited);
+		EXPECT_EQ(oram->getContainers(mixed), scanned);
+
+		EXPECT_EQ(0uLL, oram->putContainers(100, {}));
+		ASSERT_ANY_THROW(oram->putContainers(100, {{1, 2}, {3}}));
+		ASSERT_ANY_THROW(oram->putContainers(100, {vector<int64_t>(64, 0)}));
+	}
+
 	TEST_F(ORAMTest, LeavesForLocation)
 	{
 		const auto HEIGHT = 5;
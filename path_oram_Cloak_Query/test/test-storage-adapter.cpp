@@ -250,6 +250,36 @@ namespace CloakQueryPathORAM
 		ASSERT_EQ(data, returned);
 	}
 
+	TEST_P(StorageAdapterTest, AuthenticatedTamper)
+	{
+		__blockCipherMode = GCM;
+		adapter			  = createAdapter(0);
+		__blockCipherMode = CBC;
+		ASSERT_TRUE(adapter->isAuthenticated());
+
+		auto bucket = generateBucket(5);
+		adapter->set(CAPACITY - 1, bucket);
+		adapter->set(CAPACITY - 2, bucket);
+
+		vector<block> returned;
+		adapter->get(CAPACITY - 1, returned);
+		ASSERT_EQ(bucket, returned);
+
+		// IV, tag and ciphertext
+		bytes raw;
+		adapter->getInternal(CAPACITY - 1, raw);
+		ASSERT_EQ(Z * (BLOCK_SIZE + AES_BLOCK_SIZE) + GCM_IV_SIZE + AES_BLOCK_SIZE, raw.size());
+
+		// a valid bucket moved to another location
+		adapter->setInternal(CAPACITY - 2, raw);
+		ASSERT_ANY_THROW(adapter->get(CAPACITY - 2, returned));
+
+		// a modified bucket
+		raw[raw.size() - 1] ^= 0x01;
+		adapter->setInternal(CAPACITY - 1, raw);
+		ASSERT_ANY_THROW(adapter->get(CAPACITY - 1, returned));
+	}
+
 	TEST_P(StorageAdapterTest, OverrideData)
 	{
 		auto bucket = generateBucket(5);
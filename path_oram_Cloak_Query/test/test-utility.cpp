@@ -214,6 +214,82 @@ namespace CloakQueryPathORAM
 		}
 	}
 
+	TEST_F(UtilityTest, EncryptDecryptManyGCM)
+	{
+		for (number i = 0; i < 100; i++)
+		{
+			auto key		= getRandomBlock(KEYSIZE);
+			auto iv			= getRandomBlock(GCM_IV_SIZE);
+			auto input		= getRandomBlock(AES_BLOCK_SIZE * 3 + i % AES_BLOCK_SIZE + 1);
+			auto associated = getRandomBlock(i % 9);
+
+			bytes tag;
+			bytes ciphertext;
+			encryptAuthenticated(
+				key.begin(),
+				key.end(),
+				iv.begin(),
+				iv.end(),
+				input.begin(),
+				input.end(),
+				associated,
+				tag,
+				ciphertext,
+				ENCRYPT);
+
+			EXPECT_EQ(AES_BLOCK_SIZE, tag.size());
+			EXPECT_EQ(input.size(), ciphertext.size());
+			EXPECT_NE(input, ciphertext);
+
+			bytes plaintext;
+			encryptAuthenticated(
+				key.begin(),
+				key.end(),
+				iv.begin(),
+				iv.end(),
+				ciphertext.begin(),
+				ciphertext.end(),
+				associated,
+				tag,
+				plaintext,
+				DECRYPT);
+
+			ASSERT_EQ(input, plaintext);
+		}
+	}
+
+	TEST_F(UtilityTest, GCMTamper)
+	{
+		auto key		= getRandomBlock(KEYSIZE);
+		auto iv			= getRandomBlock(GCM_IV_SIZE);
+		auto input		= getRandomBlock(AES_BLOCK_SIZE * 3);
+		auto associated = getRandomBlock(sizeof(number));
+
+		bytes tag;
+		bytes ciphertext;
+		encryptAuthenticated(key.begin(), key.end(), iv.begin(), iv.end(), input.begin(), input.end(), associated, tag, ciphertext, ENCRYPT);
+
+		const auto decrypt = [&](const bytes &data, const bytes &associated, bytes tag) {
+			bytes plaintext;
+			encryptAuthenticated(key.begin(), key.end(), iv.begin(), iv.end(), data.begin(), data.end(), associated, tag, plaintext, DECRYPT);
+		};
+
+		ASSERT_NO_THROW(decrypt(ciphertext, associated, tag));
+
+		auto modified = ciphertext;
+		modified[5] ^= 0x01;
+		ASSERT_ANY_THROW(decrypt(modified, associated, tag));
+
+		auto otherAssociated = associated;
+		otherAssociated[0] ^= 0x01;
+		ASSERT_ANY_THROW(decrypt(ciphertext, otherAssociated, tag));
+
+		auto otherTag = tag;
+		otherTag[0] ^= 0x01;
+		ASSERT_ANY_THROW(decrypt(ciphertext, associated, otherTag));
+		ASSERT_ANY_THROW(decrypt(ciphertext, associated, bytes(AES_BLOCK_SIZE - 1)));
+	}
+
 	TEST_F(UtilityTest, EncryptDecryptNoEncryption)
 	{
 		__blockCipherMode = NONE;
@@ -269,6 +345,29 @@ namespace CloakQueryPathORAM
 		});
 	}
 
+	TEST_F(UtilityTest, TraceRingBuffer)
+	{
+		traceMessage(TRACE_INFO, "first");
+		traceMessage(TRACE_WARNING, boost::format("second %1%") % 2);
+
+		vector<string> trace;
+		getTrace(trace);
+		ASSERT_LE(2, trace.size());
+		EXPECT_EQ("[INFO] first", trace[trace.size() - 2]);
+		EXPECT_EQ("[WARNING] second 2", trace.back());
+
+		// only the latest TRACE_BUFFER_SIZE messages are kept
+		for (auto i = 0; i < TRACE_BUFFER_SIZE; i++)
+		{
+			traceMessage(TRACE_ACCESS, to_string(i));
+		}
+		trace.clear();
+		getTrace(trace);
+		ASSERT_EQ(TRACE_BUFFER_SIZE, trace.size());
+		EXPECT_EQ("[ACCESS] 0", trace.front());
+		EXPECT_EQ("[ACCESS] " + to_string(TRACE_BUFFER_SIZE - 1), trace.back());
+	}
+
 	TEST_F(UtilityTest, LoadStoreKey)
 	{
 		auto key = getRandomBlock(KEYSIZE);
@@ -314,6 +413,153 @@ namespace CloakQueryPathORAM
 		ASSERT_EQ(HASHSIZE / 16, digest.size());
 	}
 
+	TEST_F(UtilityTest, MacContextMatchesHmac)
+	{
+		auto key = getRandomBlock(KEYSIZE);
+		MacContext context(key);
+
+		vector<bucket> buckets;
+		for (auto b = 0uLL; b < 3; b++)
+		{
+			bucket data;
+			for (auto i = 0uLL; i < 4; i++)
+			{
+				data.push_back({i, getRandomBlock(64)});
+			}
+			buckets.push_back(data);
+		}
+
+		vector<const bucket *> pointers;
+		vector<bytes> expected;
+		for (auto &&data : buckets)
+		{
+			bytes concatenated;
+			for (auto i = 0uLL; i < 3; i++)
+			{
+				concatenated.insert(concatenated.end(), data[i].second.begin(), data[i].second.end());
+			}
+			expected.push_back(hmac(key, concatenated));
+			pointers.push_back(&data);
+
+			// repeated digests start from the same keyed state
+			EXPECT_EQ(expected.back(), context.digest(data, 3));
+			EXPECT_EQ(expected.back(), context.digest(data, 3));
+		}
+
+		vector<bytes> batch;
+		context.digests(pointers, 3, batch);
+		EXPECT_EQ(expected, batch);
+		EXPECT_NE(batch[0], batch[1]);
+
+		MacContext other(getRandomBlock(KEYSIZE));
+		EXPECT_NE(expected[0], other.digest(buckets[0], 3));
+	}
+
+	TEST_F(UtilityTest, GcmContextMatchesEncryptAuthenticated)
+	{
+		auto key = getRandomBlock(KEYSIZE);
+		GcmContext context(key);
+
+		for (number i = 0; i < 20; i++)
+		{
+			auto iv			= getRandomBlock(GCM_IV_SIZE);
+			auto input		= getRandomBlock(AES_BLOCK_SIZE * 2 + i);
+			auto associated = getRandomBlock(i % 9);
+
+			bytes expectedTag, expected;
+			encryptAuthenticated(key.begin(), key.end(), iv.begin(), iv.end(), input.begin(), input.end(), associated, expectedTag, expected, ENCRYPT);
+
+			// the same context for every message, only the IV changes
+			bytes tag, ciphertext;
+			context.encrypt(iv.begin(), iv.end(), input.begin(), input.end(), associated, tag, ciphertext, ENCRYPT);
+			EXPECT_EQ(expectedTag, tag);
+			EXPECT_EQ(expected, ciphertext);
+
+			// a failed verification does not spoil the next message
+			auto otherTag = tag;
+			otherTag[0] ^= 0x01;
+			bytes rejected;
+			ASSERT_ANY_THROW(context.encrypt(iv.begin(), iv.end(), ciphertext.begin(), ciphertext.end(), associated, otherTag, rejected, DECRYPT));
+			EXPECT_EQ(0, rejected.size());
+
+			bytes plaintext;
+			context.encrypt(iv.begin(), iv.end(), ciphertext.begin(), ciphertext.end(), associated, tag, plaintext, DECRYPT);
+			ASSERT_EQ(input, plaintext);
+		}
+
+		// IV must be GCM_IV_SIZE
+		auto iv = getRandomBlock(AES_BLOCK_SIZE);
+		bytes tag, output;
+		ASSERT_ANY_THROW(context.encrypt(iv.begin(), iv.end(), key.begin(), key.end(), bytes(), tag, output, ENCRYPT));
+		ASSERT_ANY_THROW(GcmContext(bytes(KEYSIZE - 1)));
+	}
+
+	TEST_F(UtilityTest, ContainerEncodeDecode)
+	{
+		const auto ROWS = 100uLL;
+
+		vector<vector<int64_t>> container;
+		for (number r = 0; r < ROWS; r++)
+		{
+			container.push_back({
+				(int64_t)r,							 // key
+				20240101 + (int64_t)r % 365,		 // date
+				-70000 + (int64_t)r * 1000,			 // 4 bytes range, negative base
+				(int64_t)getRandomULong(ULONG_MAX), // share
+				42,									 // constant
+			});
+		}
+
+		auto encoded = encodeContainer(container);
+		ASSERT_TRUE(ContainerView::matches(encoded));
+		EXPECT_LT(encoded.size(), serialize(container).size());
+
+		// trailing padding of a block is ignored
+		encoded.resize(encoded.size() + 100, 0x00);
+		ContainerView view(encoded);
+		ASSERT_EQ(ROWS, view.rows());
+		ASSERT_EQ(5uLL, view.attributes());
+
+		EXPECT_EQ(container, view.toRows());
+		for (number r = 0; r < ROWS; r++)
+		{
+			for (number a = 0; a < view.attributes(); a++)
+			{
+				EXPECT_EQ(container[r][a], view.at(r, a));
+			}
+		}
+
+		vector<int64_t> column(ROWS);
+		view.column(3, column.data());
+		for (number r = 0; r < ROWS; r++)
+		{
+			EXPECT_EQ(container[r][3], column[r]);
+		}
+	}
+
+	TEST_F(UtilityTest, ContainerExtremes)
+	{
+		vector<vector<int64_t>> container = {{LLONG_MIN, 0}, {LLONG_MAX, -1}};
+		auto encoded					  = encodeContainer(container);
+		EXPECT_EQ(container, ContainerView(encoded).toRows());
+
+		auto empty = encodeContainer({});
+		EXPECT_EQ(0uLL, ContainerView(empty).rows());
+		EXPECT_TRUE(ContainerView(empty).toRows().empty());
+	}
+
+	TEST_F(UtilityTest, ContainerErrors)
+	{
+		ASSERT_ANY_THROW(encodeContainer({{1, 2}, {3}}));
+
+		auto encoded = encodeContainer({{1, 2}, {3, 4}});
+		ASSERT_ANY_THROW(ContainerView(bytes(encoded.begin(), encoded.end() - 1)));
+		ASSERT_ANY_THROW(ContainerView(bytes(3)));
+		ASSERT_ANY_THROW(ContainerView(bytes(100)));
+		ASSERT_ANY_THROW(ContainerView(encoded).at(2, 0));
+		ASSERT_ANY_THROW(ContainerView(encoded).at(0, 2));
+	}
+
 	TEST_F(UtilityTest, HashToNumberUniform)
 	{
 		const auto RUNS = 10000uLL;